@@ -0,0 +1,91 @@
+#include "chunker.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace stx {
+namespace dedup {
+
+namespace {
+
+// Top 13 bits of the gear hash -> one boundary per ~8 KiB of input.
+constexpr uint64_t CUT_MASK = 0xFFF8000000000000ULL;
+constexpr size_t READ_SIZE = 1024 * 1024;
+
+struct GearTable {
+    uint64_t v[256];
+
+    // Fixed-seed splitmix64 so every sender produces identical boundaries.
+    GearTable() {
+        uint64_t x = 0x5354582d43444321ULL;
+        for (size_t i = 0; i < 256; ++i) {
+            uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            v[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+const GearTable& gear() {
+    static const GearTable table;
+    return table;
+}
+
+}
+
+std::vector<ChunkRef> chunkStream(std::istream& in, uint64_t begin, uint64_t end, size_t maxChunks) {
+    std::vector<ChunkRef> chunks;
+    if (begin >= end || maxChunks == 0)
+        return chunks;
+
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(begin));
+    if (!in)
+        throw std::runtime_error("chunkStream: seek failed");
+
+    const uint64_t* table = gear().v;
+    std::vector<uint8_t> buf(READ_SIZE);
+    std::vector<uint8_t> cur;
+    cur.reserve(CHUNK_MAX_SIZE);
+
+    uint64_t pos = begin;
+    uint64_t h = 0;
+
+    auto emit = [&]() {
+        ChunkRef ref;
+        ref.offset = pos - cur.size();
+        ref.length = cur.size();
+        ref.hash   = crypto::sha256(cur.data(), cur.size());
+        chunks.push_back(ref);
+        cur.clear();
+        h = 0;
+    };
+
+    while (pos < end) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(READ_SIZE, end - pos));
+        in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(want));
+        std::streamsize got = in.gcount();
+        if (got <= 0)
+            throw std::runtime_error("chunkStream: unexpected end of file");
+
+        for (std::streamsize i = 0; i < got; ++i) {
+            uint8_t b = buf[static_cast<size_t>(i)];
+            cur.push_back(b);
+            ++pos;
+            h = (h << 1) + table[b];
+            if ((cur.size() >= CHUNK_MIN_SIZE && (h & CUT_MASK) == 0) || cur.size() >= CHUNK_MAX_SIZE) {
+                emit();
+                if (chunks.size() == maxChunks)
+                    return chunks;
+            }
+        }
+    }
+
+    if (!cur.empty())
+        emit();
+
+    return chunks;
+}
+
+}
+}
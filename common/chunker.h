@@ -0,0 +1,33 @@
+#pragma once
+
+#include "crypto.h"
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+namespace stx {
+namespace dedup {
+
+// Content-defined chunking bounds (gear rolling hash, ~8 KiB average chunk).
+constexpr size_t CHUNK_MIN_SIZE = 2 * 1024;
+constexpr size_t CHUNK_AVG_SIZE = 8 * 1024;
+constexpr size_t CHUNK_MAX_SIZE = 64 * 1024;
+
+struct ChunkRef {
+    uint64_t offset;
+    uint64_t length;
+    crypto::Sha256Digest hash;
+};
+
+// Splits bytes [begin, end) of the stream into content-defined chunks.
+// Boundaries depend only on the data, so an insertion early in a file
+// does not shift the hashes of the chunks that follow it.
+//
+// Stops after maxChunks chunks. Chunking restarts cleanly at every boundary,
+// so continuing from the end of the last chunk returned yields the same
+// chunks as a single pass.
+std::vector<ChunkRef> chunkStream(std::istream& in, uint64_t begin, uint64_t end,
+                                  size_t maxChunks = SIZE_MAX);
+
+}
+}
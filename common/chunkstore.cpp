@@ -0,0 +1,315 @@
+#include "chunkstore.h"
+#include "chunker.h"
+#include "common.h"
+#include <windows.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace stx {
+namespace dedup {
+
+struct ChunkStore::Header {
+    char     magic[8];
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t reserved;
+};
+
+struct ChunkStore::Slot {
+    uint8_t  hash[32];
+    uint64_t offset;
+    uint64_t length;     // 0 marks an empty slot
+};
+
+namespace {
+
+const char INDEX_MAGIC[8] = { 'S', 'T', 'X', 'I', 'D', 'X', '0', '1' };
+constexpr uint64_t INITIAL_CAPACITY = uint64_t(1) << 16;
+constexpr uint64_t GROW_RETRY_PUTS  = 4096;
+constexpr uint64_t FREE_CHECK_BYTES = 64ULL * 1024 * 1024;    // re-query free space this often
+
+}
+
+uint64_t ChunkStore::indexBytes(uint64_t capacity) noexcept {
+    static_assert(sizeof(Header) == 32, "index header layout");
+    static_assert(sizeof(Slot) == 48, "index slot layout");
+    return sizeof(Header) + capacity * sizeof(Slot);
+}
+
+ChunkStore::ChunkStore(const std::string& dir, uint64_t maxPackBytes)
+    : _dir(dir),
+      _indexPath(dir + "/index.bin"),
+      _packPath(dir + "/pack.bin"),
+      _packBytes(0),
+      _maxPackBytes(maxPackBytes),
+      _freeCheckedUpTo(0),
+      _file(INVALID_HANDLE_VALUE),
+      _mapping(nullptr),
+      _view(nullptr),
+      _growBackoff(0) {
+    _file = CreateFileA(_indexPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open chunk index: " + _indexPath);
+
+    LARGE_INTEGER existing;
+    if (!GetFileSizeEx(_file, &existing)) {
+        CloseHandle(_file);
+        throw std::runtime_error("Failed to stat chunk index: " + _indexPath);
+    }
+
+    uint64_t bytes = static_cast<uint64_t>(existing.QuadPart);
+    uint64_t capacity = bytes > sizeof(Header) ? (bytes - sizeof(Header)) / sizeof(Slot) : 0;
+    bool valid = false;
+
+    try {
+        if (capacity >= INITIAL_CAPACITY && (capacity & (capacity - 1)) == 0) {
+            mapIndex(capacity);
+            valid = std::memcmp(header()->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                    header()->capacity == capacity;
+            if (!valid)
+                unmapIndex();
+        }
+
+        // Missing or damaged index: the pack is useless without it, start both afresh.
+        if (!valid) {
+            mapIndex(INITIAL_CAPACITY);
+            std::memset(_view, 0, static_cast<size_t>(indexBytes(INITIAL_CAPACITY)));
+            std::memcpy(header()->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+            header()->capacity = INITIAL_CAPACITY;
+        }
+    }
+    catch (...) {
+        unmapIndex();
+        CloseHandle(_file);
+        throw;
+    }
+
+    std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+    _pack.open(_packPath, mode | (valid ? std::ios::app : std::ios::trunc));
+    if (!_pack) {
+        unmapIndex();
+        CloseHandle(_file);
+        throw std::runtime_error("Failed to open chunk pack: " + _packPath);
+    }
+    _pack.seekp(0, std::ios::end);
+    _packBytes = static_cast<uint64_t>(_pack.tellp());
+}
+
+ChunkStore::~ChunkStore() {
+    if (_view)
+        FlushViewOfFile(_view, 0);
+    unmapIndex();
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+}
+
+void ChunkStore::mapIndex(uint64_t capacity) {
+    uint64_t bytes = indexBytes(capacity);
+
+    // Mapping beyond the current end of file extends it with zeroes.
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE,
+                                  static_cast<DWORD>(bytes >> 32),
+                                  static_cast<DWORD>(bytes & 0xFFFFFFFFULL), nullptr);
+    if (!_mapping)
+        throw std::runtime_error("CreateFileMapping failed for " + _indexPath);
+
+    _view = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<size_t>(bytes));
+    if (!_view) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+        throw std::runtime_error("MapViewOfFile failed for " + _indexPath);
+    }
+}
+
+void ChunkStore::unmapIndex() noexcept {
+    if (_view) {
+        UnmapViewOfFile(_view);
+        _view = nullptr;
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+    }
+}
+
+ChunkStore::Header* ChunkStore::header() const noexcept {
+    return static_cast<Header*>(_view);
+}
+
+ChunkStore::Slot* ChunkStore::slots() const noexcept {
+    return reinterpret_cast<Slot*>(header() + 1);
+}
+
+namespace {
+
+uint64_t homeSlot(const uint8_t* hash, uint64_t mask) noexcept {
+    uint64_t key;
+    std::memcpy(&key, hash, sizeof(key));
+    return key & mask;
+}
+
+}
+
+ChunkStore::Slot* ChunkStore::findSlot(const uint8_t* hash) const noexcept {
+    const uint64_t mask = header()->capacity - 1;
+
+    // Linear probing; load factor is capped at 3/4 so an empty slot always exists.
+    Slot* table = slots();
+    for (uint64_t i = homeSlot(hash, mask);; i = (i + 1) & mask) {
+        Slot& s = table[i];
+        if (s.length == 0 || std::memcmp(s.hash, hash, sizeof(s.hash)) == 0)
+            return &s;
+    }
+}
+
+void ChunkStore::erase(Slot* slot) noexcept {
+    const uint64_t mask = header()->capacity - 1;
+    Slot* table = slots();
+
+    // Backward-shift deletion: pull later entries of the probe run into the
+    // hole unless that would move them before their home slot.
+    uint64_t hole = static_cast<uint64_t>(slot - table);
+    for (uint64_t j = (hole + 1) & mask; table[j].length != 0; j = (j + 1) & mask) {
+        uint64_t home = homeSlot(table[j].hash, mask);
+        bool movable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+        if (movable) {
+            table[hole] = table[j];
+            hole = j;
+        }
+    }
+
+    std::memset(&table[hole], 0, sizeof(Slot));
+    --header()->count;
+}
+
+void ChunkStore::grow() {
+    const uint64_t oldCap = header()->capacity;
+    std::vector<Slot> live;
+    live.reserve(static_cast<size_t>(header()->count));
+    for (uint64_t i = 0; i < oldCap; ++i)
+        if (slots()[i].length != 0)
+            live.push_back(slots()[i]);
+
+    unmapIndex();
+    try {
+        mapIndex(oldCap * 2);
+    }
+    catch (const std::exception&) {
+        // The file still holds the old table. Shrink it back (a failed mapping
+        // may have extended it) and map that again; if even that fails the
+        // store stays disabled rather than leaving a dangling view.
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(indexBytes(oldCap));
+        if (SetFilePointerEx(_file, end, nullptr, FILE_BEGIN))
+            SetEndOfFile(_file);
+        try {
+            mapIndex(oldCap);
+        }
+        catch (const std::exception& ex) {
+            log_error(std::string("Chunk store disabled: ") + ex.what());
+        }
+        throw;
+    }
+
+    std::memset(slots(), 0, static_cast<size_t>(oldCap * 2 * sizeof(Slot)));
+    header()->capacity = oldCap * 2;
+    header()->count = 0;
+    for (const Slot& s : live) {
+        *findSlot(s.hash) = s;
+        ++header()->count;
+    }
+}
+
+bool ChunkStore::contains(const crypto::Sha256Digest& hash) const noexcept {
+    return _view && findSlot(hash.data())->length != 0;
+}
+
+bool ChunkStore::hasRoomFor(uint64_t bytes) noexcept {
+    if (bytes > _maxPackBytes || _packBytes > _maxPackBytes - bytes)
+        return false;
+    if (_packBytes + bytes <= _freeCheckedUpTo)
+        return true;
+
+    // One query vouches for the next FREE_CHECK_BYTES of appends.
+    ULARGE_INTEGER avail;
+    if (!GetDiskFreeSpaceExA(_dir.c_str(), &avail, nullptr, nullptr) ||
+        avail.QuadPart < STORE_FREE_MARGIN + FREE_CHECK_BYTES)
+        return false;
+    _freeCheckedUpTo = _packBytes + FREE_CHECK_BYTES;
+    return true;
+}
+
+void ChunkStore::put(const crypto::Sha256Digest& hash, const std::vector<uint8_t>& data) {
+    if (!_view || data.empty() || contains(hash) || !hasRoomFor(data.size()))
+        return;
+
+    // The store is a cache: if the index cannot grow, keep serving what it
+    // holds and only retry after GROW_RETRY_PUTS further chunks.
+    if ((header()->count + 1) * 4 > header()->capacity * 3) {
+        if (_growBackoff > 0) {
+            --_growBackoff;
+            return;
+        }
+        try {
+            grow();
+        }
+        catch (const std::exception& ex) {
+            log_error(std::string("Chunk store full, not storing: ") + ex.what());
+            _growBackoff = GROW_RETRY_PUTS;
+            return;
+        }
+    }
+
+    _pack.seekp(0, std::ios::end);
+    uint64_t offset = static_cast<uint64_t>(_pack.tellp());
+    _pack.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    _pack.flush();
+    if (!_pack)
+        throw std::runtime_error("Failed to append to chunk pack: " + _packPath);
+    _packBytes = offset + data.size();
+
+    // Publish the slot only once the payload is in the pack.
+    Slot* s = findSlot(hash.data());
+    s->offset = offset;
+    std::memcpy(s->hash, hash.data(), sizeof(s->hash));
+    s->length = data.size();
+    ++header()->count;
+}
+
+bool ChunkStore::tryLoad(const crypto::Sha256Digest& hash, std::vector<uint8_t>& out) {
+    if (!_view)
+        return false;
+
+    Slot* s = findSlot(hash.data());
+    if (s->length == 0)
+        return false;
+
+    bool intact = false;
+    if (s->length <= CHUNK_MAX_SIZE) {
+        out.resize(static_cast<size_t>(s->length));
+        _pack.seekg(static_cast<std::streamoff>(s->offset));
+        _pack.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        intact = _pack.gcount() == static_cast<std::streamsize>(out.size()) &&
+                 crypto::sha256(out.data(), out.size()) == hash;
+        _pack.clear();
+    }
+
+    if (!intact) {
+        erase(s);
+        log_error("Chunk in " + _packPath + " failed verification, dropped from store");
+    }
+    return intact;
+}
+
+void ChunkStore::load(const crypto::Sha256Digest& hash, std::vector<uint8_t>& out) {
+    if (!tryLoad(hash, out))
+        throw std::runtime_error("Chunk missing from store or failed verification");
+}
+
+uint64_t ChunkStore::size() const noexcept {
+    return _view ? header()->count : 0;
+}
+
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "crypto.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace stx {
+namespace dedup {
+
+// Persistent content-addressed chunk store kept next to the receiver's output.
+//
+//   <dir>/pack.bin   append-only chunk payloads
+//   <dir>/index.bin  open-addressing hash table (SHA-256 -> pack offset/length),
+//                    memory-mapped so lookups never touch the disk path
+//
+// If the index cannot be remapped after a failed grow, the store disables
+// itself: it reports every chunk as missing and stores nothing.
+// Every stored chunk costs disk a second time next to the output file, so
+// put() stops storing once the pack would exceed maxPackBytes or leave less
+// than STORE_FREE_MARGIN free on the volume.
+constexpr uint64_t DEFAULT_STORE_LIMIT = 8ULL * 1024 * 1024 * 1024;
+constexpr uint64_t STORE_FREE_MARGIN   = 1024ULL * 1024 * 1024;
+
+class ChunkStore {
+public:
+    explicit ChunkStore(const std::string& dir, uint64_t maxPackBytes = DEFAULT_STORE_LIMIT);
+    ~ChunkStore();
+
+    ChunkStore(const ChunkStore&) = delete;
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    bool contains(const crypto::Sha256Digest& hash) const noexcept;
+    void put(const crypto::Sha256Digest& hash, const std::vector<uint8_t>& data);
+
+    // Reads the chunk back and re-hashes it. A chunk whose bytes no longer
+    // match (e.g. a pack write lost in a crash) is dropped from the index so
+    // the next transfer resends it; tryLoad then returns false, load throws.
+    bool tryLoad(const crypto::Sha256Digest& hash, std::vector<uint8_t>& out);
+    void load(const crypto::Sha256Digest& hash, std::vector<uint8_t>& out);
+
+    uint64_t size() const noexcept;
+
+private:
+    struct Header;
+    struct Slot;
+
+    static uint64_t indexBytes(uint64_t capacity) noexcept;
+    void mapIndex(uint64_t capacity);
+    void unmapIndex() noexcept;
+    void grow();
+    Header* header() const noexcept;
+    Slot* slots() const noexcept;
+    Slot* findSlot(const uint8_t* hash) const noexcept;
+    void erase(Slot* slot) noexcept;
+    bool hasRoomFor(uint64_t bytes) noexcept;
+
+    std::string _dir;
+    std::string _indexPath;
+    std::string _packPath;
+    std::fstream _pack;
+    uint64_t _packBytes;
+    uint64_t _maxPackBytes;
+    uint64_t _freeCheckedUpTo;      // pack size up to which free space was last confirmed
+
+    void* _file;
+    void* _mapping;
+    void* _view;
+    uint64_t _growBackoff;
+};
+
+}
+}
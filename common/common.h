@@ -9,6 +9,15 @@ namespace stx {
 constexpr size_t BLOCK_SIZE = 4096;       
 constexpr size_t MAX_FILENAME_LEN = 256;
 
+// Hard per-session limits on peer-supplied lengths. A session holds at most the
+// 1 MiB write buffer, one manifest window (160 KiB on the wire, 192 KiB decoded),
+// one 64 KiB chunk and one record: about 1.4 MiB.
+constexpr size_t AES_IV_LEN          = 16;
+constexpr size_t MAX_RECORD_SIZE     = 64 * 1024;
+constexpr size_t MAX_WRAPPED_KEY_LEN = 1024;
+constexpr size_t MANIFEST_WINDOW     = 4096;      // chunks per manifest round trip
+constexpr uint32_t SESSION_RECV_TIMEOUT_MS = 30000;
+
 enum ExitCode {
     SUCCESS = 0,
     NETWORK_ERROR = 1,
@@ -38,42 +38,42 @@ std::vector<uint8_t> generateSessionKey(size_t keySize) {
 }
 
 std::vector<uint8_t> rsaEncrypt(EVP_PKEY* key, const std::vector<uint8_t>& data) {
-    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(key, nullptr);
+    EVP_PKEY_CTX_ptr ctx(EVP_PKEY_CTX_new(key, nullptr), EVP_PKEY_CTX_free);
     if (!ctx)
         throw std::runtime_error("EVP_PKEY_CTX_new failed");
 
-    if (EVP_PKEY_encrypt_init(ctx) <= 0)
+    if (EVP_PKEY_encrypt_init(ctx.get()) <= 0)
         throw std::runtime_error("EVP_PKEY_encrypt_init failed");
 
     size_t outlen;
-    if (EVP_PKEY_encrypt(ctx, nullptr, &outlen, data.data(), data.size()) <= 0)
+    if (EVP_PKEY_encrypt(ctx.get(), nullptr, &outlen, data.data(), data.size()) <= 0)
         throw std::runtime_error("EVP_PKEY_encrypt (sizing) failed");
 
     std::vector<uint8_t> out(outlen);
-    if (EVP_PKEY_encrypt(ctx, out.data(), &outlen, data.data(), data.size()) <= 0)
+    if (EVP_PKEY_encrypt(ctx.get(), out.data(), &outlen, data.data(), data.size()) <= 0)
         throw std::runtime_error("EVP_PKEY_encrypt failed");
 
-    EVP_PKEY_CTX_free(ctx);
+    out.resize(outlen);
     return out;
 }
 
 std::vector<uint8_t> rsaDecrypt(EVP_PKEY* key, const std::vector<uint8_t>& enc) {
-    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(key, nullptr);
+    EVP_PKEY_CTX_ptr ctx(EVP_PKEY_CTX_new(key, nullptr), EVP_PKEY_CTX_free);
     if (!ctx)
         throw std::runtime_error("EVP_PKEY_CTX_new failed");
 
-    if (EVP_PKEY_decrypt_init(ctx) <= 0)
+    if (EVP_PKEY_decrypt_init(ctx.get()) <= 0)
         throw std::runtime_error("EVP_PKEY_decrypt_init failed");
 
     size_t outlen;
-    if (EVP_PKEY_decrypt(ctx, nullptr, &outlen, enc.data(), enc.size()) <= 0)
+    if (EVP_PKEY_decrypt(ctx.get(), nullptr, &outlen, enc.data(), enc.size()) <= 0)
         throw std::runtime_error("EVP_PKEY_decrypt (sizing) failed");
 
     std::vector<uint8_t> out(outlen);
-    if (EVP_PKEY_decrypt(ctx, out.data(), &outlen, enc.data(), enc.size()) <= 0)
+    if (EVP_PKEY_decrypt(ctx.get(), out.data(), &outlen, enc.data(), enc.size()) <= 0)
         throw std::runtime_error("EVP_PKEY_decrypt failed");
 
-    EVP_PKEY_CTX_free(ctx);
+    out.resize(outlen);
     return out;
 }
 
@@ -123,5 +123,13 @@ std::vector<uint8_t> aesDecrypt(const std::vector<uint8_t>& ciphertext, const st
     return plaintext;
 }
 
+Sha256Digest sha256(const uint8_t* data, size_t len) {
+    Sha256Digest digest;
+    unsigned int outlen = 0;
+    if (EVP_Digest(data, len, digest.data(), &outlen, EVP_sha256(), nullptr) != 1 || outlen != digest.size())
+        throw std::runtime_error("EVP_Digest (SHA-256) failed");
+    return digest;
+}
+
 }  // namespace stx::crypto
 }
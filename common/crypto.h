@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <memory>
@@ -11,7 +12,9 @@ namespace stx {
 namespace crypto {
 
 using EVP_PKEY_ptr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+using EVP_PKEY_CTX_ptr = std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)>;
 using EVP_CIPHER_CTX_ptr = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+using Sha256Digest = std::array<uint8_t, 32>;
 
 class RSAKey {
 public:
@@ -30,5 +33,7 @@ std::vector<uint8_t> rsaDecrypt(EVP_PKEY* key, const std::vector<uint8_t>& enc);
 std::vector<uint8_t> aesEncrypt(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key, std::vector<uint8_t>& iv_out);
 std::vector<uint8_t> aesDecrypt(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
 
+Sha256Digest sha256(const uint8_t* data, size_t len);
+
 }  
 }
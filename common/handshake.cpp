@@ -0,0 +1,193 @@
+#include "handshake.h"
+#include <cstring>
+
+namespace stx {
+namespace transfer {
+
+namespace {
+
+void putLE16(uint8_t* p, uint16_t v) noexcept {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+void putLE32(uint8_t* p, uint32_t v) noexcept {
+    for (int i = 0; i < 4; ++i)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+void putLE64(uint8_t* p, uint64_t v) noexcept {
+    for (int i = 0; i < 8; ++i)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+uint16_t getLE16(const uint8_t* p) noexcept {
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t getLE32(const uint8_t* p) noexcept {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+uint64_t getLE64(const uint8_t* p) noexcept {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+// Returns the first bit of `prefs` present in both masks, or 0.
+uint32_t pickFirst(uint32_t offer, uint32_t local, const uint32_t* prefs, size_t n) noexcept {
+    for (size_t i = 0; i < n; ++i)
+        if (offer & local & prefs[i])
+            return prefs[i];
+    return 0;
+}
+
+bool validFilename(const char* name, size_t len) noexcept {
+    if (len == 0 || len > MAX_FILENAME_LEN)
+        return false;
+    if ((len == 1 && name[0] == '.') || (len == 2 && name[0] == '.' && name[1] == '.'))
+        return false;
+    for (size_t i = 0; i < len; ++i)
+        if (name[i] == '\0' || name[i] == '/' || name[i] == '\\' || name[i] == ':')
+            return false;
+    return true;
+}
+
+}
+
+FileMetadata Handshake::metadata() const {
+    FileMetadata meta;
+    meta.filename.assign(filename, filenameLen);
+    meta.filesize = filesize;
+    meta.lastConfirmedBlock = lastConfirmedBlock;
+    return meta;
+}
+
+Capabilities localCapabilities() noexcept {
+    Capabilities caps;
+    caps.maxStreams  = 1;
+    caps.ciphers     = CIPHER_AES256_CBC;
+    caps.recordSizes = RECORD_4K | RECORD_16K | RECORD_64K;
+    caps.compression = COMPRESS_NONE;
+    caps.hashes      = HASH_SHA256;
+    return caps;
+}
+
+bool negotiate(const Capabilities& offer, const Capabilities& local, Capabilities& chosen) noexcept {
+    // Preference order: fastest first.
+    static const uint32_t ciphers[]     = { CIPHER_AES256_CBC };
+    static const uint32_t records[]     = { RECORD_64K, RECORD_16K, RECORD_4K };
+    static const uint32_t compression[] = { COMPRESS_NONE };
+    static const uint32_t hashes[]      = { HASH_SHA256 };
+
+    chosen.maxStreams  = offer.maxStreams < local.maxStreams ? offer.maxStreams : local.maxStreams;
+    chosen.ciphers     = pickFirst(offer.ciphers, local.ciphers, ciphers, 1);
+    chosen.recordSizes = pickFirst(offer.recordSizes, local.recordSizes, records, 3);
+    chosen.compression = pickFirst(offer.compression, local.compression, compression, 1);
+    chosen.hashes      = pickFirst(offer.hashes, local.hashes, hashes, 1);
+
+    return chosen.maxStreams != 0 && chosen.ciphers != 0 && chosen.recordSizes != 0 &&
+           chosen.compression != 0 && chosen.hashes != 0;
+}
+
+size_t recordSize(uint32_t recordBit) noexcept {
+    switch (recordBit) {
+    case RECORD_4K:  return 4 * 1024;
+    case RECORD_16K: return 16 * 1024;
+    case RECORD_64K: return 64 * 1024;
+    default:         return 0;
+    }
+}
+
+bool makeHandshake(const FileMetadata& meta, const Capabilities& caps, Handshake& out) noexcept {
+    if (!validFilename(meta.filename.data(), meta.filename.size()))
+        return false;
+
+    out.version            = PROTOCOL_VERSION;
+    out.caps               = caps;
+    out.filesize           = meta.filesize;
+    out.lastConfirmedBlock = meta.lastConfirmedBlock;
+    out.filenameLen        = static_cast<uint16_t>(meta.filename.size());
+    std::memcpy(out.filename, meta.filename.data(), meta.filename.size());
+    return true;
+}
+
+size_t encodeHandshake(const Handshake& hs, uint8_t* buf, size_t len) noexcept {
+    size_t total = HANDSHAKE_FIXED_SIZE + hs.filenameLen;
+    if (hs.filenameLen > MAX_FILENAME_LEN || len < total)
+        return 0;
+
+    putLE32(buf + 0,  HANDSHAKE_MAGIC);
+    putLE16(buf + 4,  hs.version);
+    putLE16(buf + 6,  hs.caps.maxStreams);
+    putLE32(buf + 8,  hs.caps.ciphers);
+    putLE32(buf + 12, hs.caps.recordSizes);
+    putLE32(buf + 16, hs.caps.compression);
+    putLE32(buf + 20, hs.caps.hashes);
+    putLE64(buf + 24, hs.filesize);
+    putLE64(buf + 32, hs.lastConfirmedBlock);
+    putLE16(buf + 40, hs.filenameLen);
+    std::memcpy(buf + HANDSHAKE_FIXED_SIZE, hs.filename, hs.filenameLen);
+    return total;
+}
+
+bool decodeHandshake(const uint8_t* buf, size_t len, Handshake& out) noexcept {
+    if (len < HANDSHAKE_FIXED_SIZE || getLE32(buf) != HANDSHAKE_MAGIC)
+        return false;
+
+    uint16_t nameLen = getLE16(buf + 40);
+    if (nameLen > MAX_FILENAME_LEN || len != HANDSHAKE_FIXED_SIZE + nameLen)
+        return false;
+
+    const char* name = reinterpret_cast<const char*>(buf + HANDSHAKE_FIXED_SIZE);
+    if (!validFilename(name, nameLen))
+        return false;
+
+    out.version            = getLE16(buf + 4);
+    out.caps.maxStreams    = getLE16(buf + 6);
+    out.caps.ciphers       = getLE32(buf + 8);
+    out.caps.recordSizes   = getLE32(buf + 12);
+    out.caps.compression   = getLE32(buf + 16);
+    out.caps.hashes        = getLE32(buf + 20);
+    out.filesize           = getLE64(buf + 24);
+    out.lastConfirmedBlock = getLE64(buf + 32);
+    out.filenameLen        = nameLen;
+    std::memcpy(out.filename, name, nameLen);
+    return true;
+}
+
+bool sendHandshake(SOCKET sock, const Handshake& hs) {
+    uint8_t buf[HANDSHAKE_MAX_SIZE];
+    size_t len = encodeHandshake(hs, buf, sizeof(buf));
+    if (len == 0)
+        return false;
+    return sendAll(sock, reinterpret_cast<const char*>(buf), len);
+}
+
+bool recvHandshake(SOCKET sock, Handshake& out) {
+    uint8_t buf[HANDSHAKE_MAX_SIZE];
+    if (!recvAll(sock, reinterpret_cast<char*>(buf), HANDSHAKE_FIXED_SIZE))
+        return false;
+
+    uint16_t nameLen = getLE16(buf + 40);
+    if (nameLen > MAX_FILENAME_LEN) {
+        log_error("recvHandshake: filename too long");
+        return false;
+    }
+    if (!recvAll(sock, reinterpret_cast<char*>(buf + HANDSHAKE_FIXED_SIZE), nameLen))
+        return false;
+
+    if (!decodeHandshake(buf, HANDSHAKE_FIXED_SIZE + nameLen, out)) {
+        log_error("recvHandshake: malformed handshake frame");
+        return false;
+    }
+    return true;
+}
+
+}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "common.h"
+#include "transfer.h"
+#include <cstdint>
+
+namespace stx {
+namespace transfer {
+
+// Binary handshake frame, all integers little-endian:
+//
+//   0  u32  magic "STX1"
+//   4  u16  protocol version
+//   6  u16  max parallel streams
+//   8  u32  cipher bits
+//  12  u32  record size bits
+//  16  u32  compression bits
+//  20  u32  hash bits
+//  24  u64  file size
+//  32  u64  last confirmed block
+//  40  u16  filename length
+//  42  ...  filename bytes (at most MAX_FILENAME_LEN, no path separators)
+//
+// The sender offers every mode it supports; the receiver replies with one
+// frame carrying exactly one bit per field (or none, to refuse) and its
+// resume point in lastConfirmedBlock.
+
+constexpr uint32_t HANDSHAKE_MAGIC      = 0x31585453;   // "STX1"
+constexpr uint16_t PROTOCOL_VERSION     = 2;
+constexpr size_t   HANDSHAKE_FIXED_SIZE = 42;
+constexpr size_t   HANDSHAKE_MAX_SIZE   = HANDSHAKE_FIXED_SIZE + MAX_FILENAME_LEN;
+
+enum CipherCaps : uint32_t {
+    CIPHER_AES256_CBC = 1u << 0
+};
+
+enum RecordCaps : uint32_t {
+    RECORD_4K  = 1u << 0,
+    RECORD_16K = 1u << 1,
+    RECORD_64K = 1u << 2
+};
+
+enum CompressionCaps : uint32_t {
+    COMPRESS_NONE = 1u << 0
+};
+
+enum HashCaps : uint32_t {
+    HASH_SHA256 = 1u << 0
+};
+
+struct Capabilities {
+    uint16_t maxStreams;
+    uint32_t ciphers;
+    uint32_t recordSizes;
+    uint32_t compression;
+    uint32_t hashes;
+};
+
+struct Handshake {
+    uint16_t     version;
+    Capabilities caps;
+    uint64_t     filesize;
+    uint64_t     lastConfirmedBlock;
+    uint16_t     filenameLen;
+    char         filename[MAX_FILENAME_LEN];
+
+    FileMetadata metadata() const;
+};
+
+Capabilities localCapabilities() noexcept;
+
+// Picks the fastest mode present in both sets. Returns false if any field has no overlap.
+bool negotiate(const Capabilities& offer, const Capabilities& local, Capabilities& chosen) noexcept;
+
+size_t recordSize(uint32_t recordBit) noexcept;
+
+bool makeHandshake(const FileMetadata& meta, const Capabilities& caps, Handshake& out) noexcept;
+
+// Returns the encoded length, or 0 if buf is too small.
+size_t encodeHandshake(const Handshake& hs, uint8_t* buf, size_t len) noexcept;
+bool decodeHandshake(const uint8_t* buf, size_t len, Handshake& out) noexcept;
+
+bool sendHandshake(SOCKET sock, const Handshake& hs);
+bool recvHandshake(SOCKET sock, Handshake& out);
+
+}
+}
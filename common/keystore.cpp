@@ -0,0 +1,147 @@
+#include "keystore.h"
+#include "common.h"
+#include <atomic>
+#include <csignal>
+#include <stdexcept>
+
+namespace stx {
+namespace crypto {
+
+struct KeyStore::Keys {
+    uint64_t generation;
+    std::unique_ptr<RSAKey> priv;
+    std::unique_ptr<RSAKey> peerPub;
+};
+
+namespace {
+
+std::atomic<uint64_t> g_generation(0);
+volatile std::sig_atomic_t g_reloadRequested = 0;
+
+extern "C" void onReloadSignal(int sig) {
+    g_reloadRequested = 1;
+    std::signal(sig, onReloadSignal);   // the CRT resets handlers before calling them
+}
+
+// Contexts for the key generation this thread last used. The keep-alive
+// reference stops a reload from freeing keys a context still points at.
+struct ThreadContexts {
+    uint64_t generation = 0;
+    std::shared_ptr<const void> keys;
+    EVP_PKEY_CTX_ptr enc{nullptr, EVP_PKEY_CTX_free};
+    EVP_PKEY_CTX_ptr dec{nullptr, EVP_PKEY_CTX_free};
+};
+
+ThreadContexts& threadContexts(const std::shared_ptr<const void>& keys, uint64_t generation) {
+    thread_local ThreadContexts tc;
+    if (tc.generation != generation) {
+        tc.enc.reset();
+        tc.dec.reset();
+        tc.keys = keys;
+        tc.generation = generation;
+    }
+    return tc;
+}
+
+EVP_PKEY_CTX_ptr newContext(EVP_PKEY* key, bool encrypt) {
+    EVP_PKEY_CTX_ptr ctx(EVP_PKEY_CTX_new(key, nullptr), EVP_PKEY_CTX_free);
+    if (!ctx)
+        throw std::runtime_error("EVP_PKEY_CTX_new failed");
+
+    int rc = encrypt ? EVP_PKEY_encrypt_init(ctx.get()) : EVP_PKEY_decrypt_init(ctx.get());
+    if (rc <= 0)
+        throw std::runtime_error(encrypt ? "EVP_PKEY_encrypt_init failed" : "EVP_PKEY_decrypt_init failed");
+    return ctx;
+}
+
+}
+
+KeyStore::KeyStore(const std::string& privPath, const std::string& peerPubPath)
+    : _privPath(privPath), _peerPubPath(peerPubPath) {
+    reload();
+}
+
+void KeyStore::reload() {
+    std::shared_ptr<Keys> fresh = std::make_shared<Keys>();
+    if (!_privPath.empty())
+        fresh->priv.reset(new RSAKey(_privPath, true));
+    if (!_peerPubPath.empty())
+        fresh->peerPub.reset(new RSAKey(_peerPubPath, false));
+    fresh->generation = ++g_generation;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _keys = fresh;
+}
+
+bool KeyStore::reloadIfRequested() {
+    if (!g_reloadRequested)
+        return false;
+    g_reloadRequested = 0;
+
+    try {
+        reload();
+        return true;
+    }
+    catch (const std::exception& ex) {
+        log_error(std::string("Key reload failed, keeping previous keys: ") + ex.what());
+        return false;
+    }
+}
+
+void KeyStore::installReloadSignal() {
+#ifdef SIGHUP
+    std::signal(SIGHUP, onReloadSignal);
+#else
+    std::signal(SIGBREAK, onReloadSignal);
+#endif
+}
+
+std::shared_ptr<const KeyStore::Keys> KeyStore::snapshot() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _keys;
+}
+
+std::vector<uint8_t> KeyStore::wrapSessionKey(const std::vector<uint8_t>& key) const {
+    auto keys = snapshot();
+    if (!keys->peerPub)
+        throw std::runtime_error("No peer public key loaded");
+
+    ThreadContexts& tc = threadContexts(keys, keys->generation);
+    if (!tc.enc)
+        tc.enc = newContext(keys->peerPub->get(), true);
+
+    size_t outlen;
+    if (EVP_PKEY_encrypt(tc.enc.get(), nullptr, &outlen, key.data(), key.size()) <= 0)
+        throw std::runtime_error("EVP_PKEY_encrypt (sizing) failed");
+
+    std::vector<uint8_t> out(outlen);
+    if (EVP_PKEY_encrypt(tc.enc.get(), out.data(), &outlen, key.data(), key.size()) <= 0)
+        throw std::runtime_error("EVP_PKEY_encrypt failed");
+
+    out.resize(outlen);
+    return out;
+}
+
+std::vector<uint8_t> KeyStore::unwrapSessionKey(const std::vector<uint8_t>& enc) const {
+    auto keys = snapshot();
+    if (!keys->priv)
+        throw std::runtime_error("No private key loaded");
+
+    ThreadContexts& tc = threadContexts(keys, keys->generation);
+    if (!tc.dec)
+        tc.dec = newContext(keys->priv->get(), false);
+
+    size_t outlen;
+    if (EVP_PKEY_decrypt(tc.dec.get(), nullptr, &outlen, enc.data(), enc.size()) <= 0)
+        throw std::runtime_error("EVP_PKEY_decrypt (sizing) failed");
+
+    std::vector<uint8_t> out(outlen);
+    if (EVP_PKEY_decrypt(tc.dec.get(), out.data(), &outlen, enc.data(), enc.size()) <= 0)
+        throw std::runtime_error("EVP_PKEY_decrypt failed");
+
+    out.resize(outlen);
+    return out;
+}
+
+}
+}
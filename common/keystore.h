@@ -0,0 +1,45 @@
+#pragma once
+
+#include "crypto.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stx {
+namespace crypto {
+
+// RSA keys loaded once at startup and shared by every connection. Each thread
+// keeps its own initialised EVP_PKEY_CTX for wrapping/unwrapping session keys,
+// rebuilt only after a reload.
+//
+// installReloadSignal() hooks SIGHUP (SIGBREAK / Ctrl+Break on Windows); the
+// owner calls reloadIfRequested() from its main loop to pick up new key files.
+class KeyStore {
+public:
+    // Either path may be empty if that key is not needed by this side.
+    KeyStore(const std::string& privPath, const std::string& peerPubPath);
+
+    // Re-reads both files. On failure the previous keys stay active and this throws.
+    void reload();
+    bool reloadIfRequested();
+    static void installReloadSignal();
+
+    std::vector<uint8_t> wrapSessionKey(const std::vector<uint8_t>& key) const;
+    std::vector<uint8_t> unwrapSessionKey(const std::vector<uint8_t>& enc) const;
+
+private:
+    struct Keys;
+
+    std::shared_ptr<const Keys> snapshot() const;
+
+    std::string _privPath;
+    std::string _peerPubPath;
+
+    mutable std::mutex _lock;
+    std::shared_ptr<const Keys> _keys;
+};
+
+}
+}
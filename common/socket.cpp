@@ -77,6 +77,13 @@ SocketRAII SocketRAII::acceptClient() {
     return result;
 }
 
+void SocketRAII::setRecvTimeout(uint32_t ms) {
+    DWORD timeout = ms;
+    if (setsockopt(_sock, SOL_SOCKET, SO_RCVTIMEO,
+                   reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == SOCKET_ERROR)
+        throw std::runtime_error("Failed to set receive timeout");
+}
+
 void initWinsock() {
     WSADATA wsa;
     if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
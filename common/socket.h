@@ -27,6 +27,7 @@ public:
     void connectTo(const std::string& host, uint16_t port);
     void bindAndListen(uint16_t port);
     SocketRAII acceptClient();
+    void setRecvTimeout(uint32_t ms);
 
 private:
     SOCKET _sock;
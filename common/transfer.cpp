@@ -1,6 +1,7 @@
 #include "transfer.h"
 #include "common.h"
 #include <winsock2.h>
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
@@ -8,91 +9,169 @@
 namespace stx {
 namespace transfer {
 
-std::string FileMetadata::to_string() const {
-    return filename + "|" + std::to_string(filesize) + "|" + std::to_string(lastConfirmedBlock);
-}
+namespace {
 
-FileMetadata FileMetadata::from_string(const std::string& str) {
-    FileMetadata meta;
-    size_t p1 = str.find('|');
-    size_t p2 = str.find('|', p1 + 1);
-    if (p1 == std::string::npos || p2 == std::string::npos)
-        throw std::runtime_error("Invalid metadata format");
+uint64_t getBE64(const uint8_t* p) noexcept {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v = (v << 8) | p[i];
+    return v;
+}
 
-    meta.filename = str.substr(0, p1);
-    meta.filesize = std::stoull(str.substr(p1 + 1, p2 - p1 - 1));
-    meta.lastConfirmedBlock = std::stoull(str.substr(p2 + 1));
-    return meta;
 }
 
-bool sendMetadata(SOCKET sock, const FileMetadata& meta) {
-    std::string data = meta.to_string();
-    uint64_t len = data.size();
-    if (!sendUInt64(sock, len))
+bool sendChunkManifest(SOCKET sock, const std::vector<dedup::ChunkRef>& chunks) {
+    if (chunks.size() > MANIFEST_WINDOW || !sendUInt64(sock, chunks.size()))
         return false;
-    return send(sock, data.c_str(), static_cast<int>(data.size()), 0) == data.size();
+
+    std::vector<char> buf;
+    buf.reserve(chunks.size() * MANIFEST_ENTRY_SIZE);
+    for (const auto& c : chunks) {
+        uint64_t netlen = htonll(c.length);
+        buf.insert(buf.end(), c.hash.begin(), c.hash.end());
+        buf.insert(buf.end(), reinterpret_cast<const char*>(&netlen),
+                   reinterpret_cast<const char*>(&netlen) + sizeof(netlen));
+    }
+    return sendAll(sock, buf.data(), buf.size());
 }
 
-bool recvMetadata(SOCKET sock, FileMetadata& out) {
-    uint64_t len;
-    if (!recvUInt64(sock, len))
+bool recvChunkManifest(SOCKET sock, std::vector<dedup::ChunkRef>& chunks, uint64_t offset,
+                       uint64_t expectedBytes) {
+    uint64_t count = 0;
+    if (!recvUInt64(sock, count))
+        return false;
+
+    chunks.clear();
+    if (count == 0) {
+        if (offset != expectedBytes) {
+            log_error("recvChunkManifest: chunks do not cover the file");
+            return false;
+        }
+        return true;
+    }
+
+    if (count > MANIFEST_WINDOW) {
+        log_error("recvChunkManifest: chunk count " + std::to_string(count) + " exceeds limit");
         return false;
+    }
 
-    std::string buf(len, '\0');
-    int received = recv(sock, &buf[0], static_cast<int>(len), MSG_WAITALL);
-    if (received != len)
+    std::vector<uint8_t> buf(static_cast<size_t>(count) * MANIFEST_ENTRY_SIZE);
+    if (!recvAll(sock, reinterpret_cast<char*>(buf.data()), buf.size()))
         return false;
 
-    out = FileMetadata::from_string(buf);
+    chunks.reserve(static_cast<size_t>(count));
+    if (!decodeChunkManifest(buf.data(), buf.size(), offset, expectedBytes, chunks)) {
+        log_error("recvChunkManifest: invalid chunk length");
+        return false;
+    }
     return true;
 }
 
+bool decodeChunkManifest(const uint8_t* buf, size_t len, uint64_t offset, uint64_t expectedBytes,
+                         std::vector<dedup::ChunkRef>& out) {
+    if (len % MANIFEST_ENTRY_SIZE != 0)
+        return false;
+
+    for (const uint8_t* p = buf; p != buf + len; p += MANIFEST_ENTRY_SIZE) {
+        dedup::ChunkRef c;
+        std::copy(p, p + c.hash.size(), c.hash.begin());
+        c.length = getBE64(p + c.hash.size());
+        c.offset = offset;
+        if (c.length == 0 || c.length > dedup::CHUNK_MAX_SIZE ||
+            offset > expectedBytes || c.length > expectedBytes - offset)
+            return false;
+        offset += c.length;
+        out.push_back(c);
+    }
+    return true;
+}
+
+bool checkRecordLengths(uint64_t ivlen, uint64_t enclen, size_t maxRecord) noexcept {
+    // CBC output is whole blocks, at most one block of padding beyond the plaintext.
+    return ivlen == AES_IV_LEN &&
+           enclen >= AES_IV_LEN &&
+           enclen % AES_IV_LEN == 0 &&
+           enclen <= uint64_t(maxRecord) + AES_IV_LEN;
+}
+
+size_t decodeRecordHeader(const uint8_t* buf, size_t len, size_t maxRecord, RecordView& out) noexcept {
+    if (len < RECORD_HEADER_SIZE)
+        return 0;
+
+    uint64_t ivlen  = getBE64(buf);
+    uint64_t enclen = getBE64(buf + sizeof(uint64_t) + AES_IV_LEN);
+    if (!checkRecordLengths(ivlen, enclen, maxRecord))
+        return 0;
+
+    out.iv            = buf + sizeof(uint64_t);
+    out.ciphertext    = nullptr;
+    out.ciphertextLen = static_cast<size_t>(enclen);
+    return RECORD_HEADER_SIZE;
+}
+
+size_t decodeRecord(const uint8_t* buf, size_t len, size_t maxRecord, RecordView& out) noexcept {
+    RecordView rec;
+    if (decodeRecordHeader(buf, len, maxRecord, rec) == 0 || len - RECORD_HEADER_SIZE < rec.ciphertextLen)
+        return 0;
+
+    out.iv            = rec.iv;
+    out.ciphertext    = buf + RECORD_HEADER_SIZE;
+    out.ciphertextLen = rec.ciphertextLen;
+    return RECORD_HEADER_SIZE + out.ciphertextLen;
+}
+
 bool sendEncryptedBlock(SOCKET sock, const std::vector<uint8_t>& block, const std::vector<uint8_t>& key) {
     std::vector<uint8_t> iv;
     auto encrypted = crypto::aesEncrypt(block, key, iv);
 
     if (!sendIV(sock, iv)) return false;
     return sendUInt64(sock, encrypted.size()) &&
-           send(sock, reinterpret_cast<const char*>(encrypted.data()), static_cast<int>(encrypted.size()), 0) == encrypted.size();
+           sendAll(sock, reinterpret_cast<const char*>(encrypted.data()), encrypted.size());
 }
 
-bool recvEncryptedBlock(SOCKET sock, std::vector<uint8_t>& block, const std::vector<uint8_t>& key) {
-    uint64_t ivlen = 0;
-    if (!recvUInt64(sock, ivlen)) 
-        return false;       
+bool recvEncryptedBlock(SOCKET sock, std::vector<uint8_t>& block, const std::vector<uint8_t>& key,
+                        size_t maxRecord) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (!recvAll(sock, reinterpret_cast<char*>(header), sizeof(uint64_t)))
+        return false;
 
-    if (ivlen == 0)
-        return false;      
+    if (getBE64(header) == 0)
+        return false;
 
-    std::vector<uint8_t> iv(ivlen);
-    if (!recvAll(sock, reinterpret_cast<char*>(iv.data()), ivlen))
-        return false;     
+    if (!recvAll(sock, reinterpret_cast<char*>(header) + sizeof(uint64_t), RECORD_HEADER_SIZE - sizeof(uint64_t)))
+        return false;
 
-    uint64_t enclen = 0;
-    if (!recvUInt64(sock, enclen))
+    RecordView rec;
+    if (decodeRecordHeader(header, sizeof(header), maxRecord, rec) == 0) {
+        log_error("recvEncryptedBlock: invalid record header");
         return false;
+    }
 
-    std::vector<uint8_t> enc(enclen);
-    if (!recvAll(sock, reinterpret_cast<char*>(enc.data()), enclen))
+    std::vector<uint8_t> iv(rec.iv, rec.iv + AES_IV_LEN);
+    std::vector<uint8_t> enc(rec.ciphertextLen);
+    if (!recvAll(sock, reinterpret_cast<char*>(enc.data()), enc.size()))
         return false;
 
     block = crypto::aesDecrypt(enc, key, iv);
-        return true;
+    return true;
 }
 
 
 bool sendIV(SOCKET sock, const std::vector<uint8_t>& iv) {
     uint64_t len = iv.size();
     return sendUInt64(sock, len) &&
-           send(sock, reinterpret_cast<const char*>(iv.data()), static_cast<int>(len), 0) == len;
+           sendAll(sock, reinterpret_cast<const char*>(iv.data()), iv.size());
 }
 
 bool recvIV(SOCKET sock, std::vector<uint8_t>& iv) {
     uint64_t len;
     if (!recvUInt64(sock, len)) return false;
-    iv.resize(len);
-    int got = recv(sock, reinterpret_cast<char*>(iv.data()), static_cast<int>(len), MSG_WAITALL);
-    return got == len;
+    if (len != AES_IV_LEN) {
+        log_error("recvIV: invalid IV length " + std::to_string(len));
+        return false;
+    }
+    iv.resize(AES_IV_LEN);
+    return recvAll(sock, reinterpret_cast<char*>(iv.data()), iv.size());
 }
 
 bool sendUInt64(SOCKET sock, uint64_t value) {
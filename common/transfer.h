@@ -1,5 +1,7 @@
 #pragma once
 
+#include "chunker.h"
+#include "common.h"
 #include "crypto.h"
 #include "socket.h"
 #include <fstream>
@@ -13,16 +15,53 @@ struct FileMetadata {
     std::string filename;
     uint64_t filesize;
     uint64_t lastConfirmedBlock;
+};
+
+// Dedup manifest, sent in windows of at most MANIFEST_WINDOW chunks: count, then
+// (sha256, length) per chunk. The receiver answers each window with one byte
+// per chunk, non-zero when the chunk is already in its store, and the sender
+// then transmits the missing chunks of that window. A count of 0 ends the file;
+// the receiver answers it with TRANSFER_COMMITTED once the file is on disk.
+constexpr size_t   MANIFEST_ENTRY_SIZE = sizeof(crypto::Sha256Digest) + sizeof(uint64_t);
+constexpr uint64_t TRANSFER_COMMITTED  = 0x53545821434F4D54ULL;   // "STX!COMT"
+
+bool sendChunkManifest(SOCKET sock, const std::vector<dedup::ChunkRef>& chunks);
+
+// Receives one window whose first chunk starts at `offset` bytes into the
+// expectedBytes being transferred. An empty window is only accepted once
+// offset == expectedBytes.
+bool recvChunkManifest(SOCKET sock, std::vector<dedup::ChunkRef>& chunks, uint64_t offset,
+                       uint64_t expectedBytes);
 
-    std::string to_string() const;
-    static FileMetadata from_string(const std::string& str);
+// Parses len / MANIFEST_ENTRY_SIZE entries from buf and appends them to out,
+// numbering offsets from `offset`. Fails if len is not a whole number of
+// entries or a chunk length is zero, above CHUNK_MAX_SIZE or past expectedBytes.
+bool decodeChunkManifest(const uint8_t* buf, size_t len, uint64_t offset, uint64_t expectedBytes,
+                         std::vector<dedup::ChunkRef>& out);
+
+// Record on the wire: u64 ivlen | iv | u64 enclen | ciphertext (lengths big-endian).
+// ivlen == 0 terminates the stream.
+struct RecordView {
+    const uint8_t* iv;
+    const uint8_t* ciphertext;
+    size_t         ciphertextLen;
 };
 
-bool sendMetadata(SOCKET sock, const FileMetadata& meta);
-bool recvMetadata(SOCKET sock, FileMetadata& out);
+constexpr size_t RECORD_HEADER_SIZE = sizeof(uint64_t) + AES_IV_LEN + sizeof(uint64_t);
+
+bool checkRecordLengths(uint64_t ivlen, uint64_t enclen, size_t maxRecord) noexcept;
+
+// Parses the fixed ivlen | iv | enclen prefix. Fills iv and ciphertextLen and
+// returns RECORD_HEADER_SIZE, or 0 if buf is short or the lengths are invalid.
+size_t decodeRecordHeader(const uint8_t* buf, size_t len, size_t maxRecord, RecordView& out) noexcept;
+
+// Parses one record from buf without copying. Returns the bytes consumed, or 0
+// if the buffer is truncated or the record violates the limits.
+size_t decodeRecord(const uint8_t* buf, size_t len, size_t maxRecord, RecordView& out) noexcept;
 
 bool sendEncryptedBlock(SOCKET sock, const std::vector<uint8_t>& block, const std::vector<uint8_t>& key);
-bool recvEncryptedBlock(SOCKET sock, std::vector<uint8_t>& block, const std::vector<uint8_t>& key);
+bool recvEncryptedBlock(SOCKET sock, std::vector<uint8_t>& block, const std::vector<uint8_t>& key,
+                        size_t maxRecord = MAX_RECORD_SIZE);
 
 bool sendIV(SOCKET sock, const std::vector<uint8_t>& iv);
 bool recvIV(SOCKET sock, std::vector<uint8_t>& iv);
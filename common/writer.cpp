@@ -0,0 +1,160 @@
+#include "writer.h"
+#include "common.h"
+#include <windows.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace stx {
+namespace io {
+
+bool parseSyncPolicy(const std::string& name, SyncPolicy& out) noexcept {
+    if (name == "none")          out = SyncPolicy::None;
+    else if (name == "periodic") out = SyncPolicy::Periodic;
+    else if (name == "rename")   out = SyncPolicy::Rename;
+    else return false;
+    return true;
+}
+
+static std::string workPathOf(const std::string& path, SyncPolicy policy) {
+    return policy == SyncPolicy::Rename ? path + ".part" : path;
+}
+
+uint64_t FileWriter::resumeBlockOf(const std::string& path, SyncPolicy policy) noexcept {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(workPathOf(path, policy).c_str(), GetFileExInfoStandard, &info))
+        return 0;
+
+    // The sender resumes on a block boundary; trimTail() drops the rest.
+    uint64_t size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    return size / BLOCK_SIZE;
+}
+
+FileWriter::FileWriter(const std::string& path, SyncPolicy policy, uint64_t resumeBlock)
+    : _path(path),
+      _workPath(workPathOf(path, policy)),
+      _policy(policy),
+      _file(INVALID_HANDLE_VALUE),
+      _offset(resumeBlock * BLOCK_SIZE),
+      _unsynced(0),
+      _trimmed(false) {
+    _file = CreateFileA(_workPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open " + _workPath);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || static_cast<uint64_t>(size.QuadPart) < _offset) {
+        CloseHandle(_file);
+        throw std::runtime_error("Cannot resume " + _workPath + " at block " + std::to_string(resumeBlock));
+    }
+
+    _buf.reserve(WRITE_COALESCE_SIZE);
+}
+
+FileWriter::~FileWriter() {
+    if (_file == INVALID_HANDLE_VALUE)
+        return;
+
+    // Keep whatever was received so an interrupted transfer can resume.
+    try {
+        flushBuffer();
+    }
+    catch (const std::exception& ex) {
+        log_error(ex.what());
+    }
+    CloseHandle(_file);
+}
+
+void FileWriter::preallocate(uint64_t size) noexcept {
+    if (size <= _offset)
+        return;
+
+    size_t slash = _workPath.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? std::string() : _workPath.substr(0, slash + 1);
+    ULARGE_INTEGER avail;
+    if (!GetDiskFreeSpaceExA(dir.empty() ? nullptr : dir.c_str(), &avail, nullptr, nullptr))
+        return;
+
+    uint64_t spare = avail.QuadPart > PREALLOCATE_MARGIN ? avail.QuadPart - PREALLOCATE_MARGIN : 0;
+    if (size - _offset > spare)
+        size = _offset + spare;
+    if (size <= _offset)
+        return;
+
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFileInformationByHandle(_file, FileAllocationInfo, &info, sizeof(info)))
+        log_debug("preallocate: SetFileInformationByHandle failed, error " + std::to_string(GetLastError()));
+}
+
+void FileWriter::write(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        size_t n = WRITE_COALESCE_SIZE - _buf.size();
+        if (n > len)
+            n = len;
+        _buf.insert(_buf.end(), data, data + n);
+        data += n;
+        len  -= n;
+
+        if (_buf.size() == WRITE_COALESCE_SIZE)
+            flushBuffer();
+    }
+}
+
+void FileWriter::trimTail() {
+    if (_trimmed)
+        return;
+
+    LARGE_INTEGER pos;
+    pos.QuadPart = static_cast<LONGLONG>(_offset);
+    if (!SetFilePointerEx(_file, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(_file))
+        throw std::runtime_error("Cannot truncate " + _workPath);
+    _trimmed = true;
+}
+
+void FileWriter::flushBuffer() {
+    if (_buf.empty())
+        return;
+
+    trimTail();
+
+    DWORD written = 0;
+    if (!WriteFile(_file, _buf.data(), static_cast<DWORD>(_buf.size()), &written, nullptr) ||
+        written != _buf.size())
+        throw std::runtime_error("Write failed: " + _workPath);
+
+    _offset   += written;
+    _unsynced += written;
+    _buf.clear();
+
+    if (_policy == SyncPolicy::Periodic && _unsynced >= PERIODIC_SYNC_BYTES)
+        sync();
+}
+
+void FileWriter::sync() {
+    if (!FlushFileBuffers(_file))
+        throw std::runtime_error("FlushFileBuffers failed: " + _workPath);
+    _unsynced = 0;
+}
+
+void FileWriter::commit(uint64_t expectedSize) {
+    trimTail();
+    flushBuffer();
+    if (_offset != expectedSize)
+        throw std::runtime_error("Incomplete file " + _workPath + ": " + std::to_string(_offset) +
+                                 " of " + std::to_string(expectedSize) + " bytes");
+    if (_policy == SyncPolicy::None)
+        return;
+
+    sync();
+    if (_policy != SyncPolicy::Rename)
+        return;
+
+    CloseHandle(_file);
+    _file = INVALID_HANDLE_VALUE;
+    if (!MoveFileExA(_workPath.c_str(), _path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        throw std::runtime_error("Cannot rename " + _workPath + " to " + _path);
+}
+
+}
+}
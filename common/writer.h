@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stx {
+namespace io {
+
+// When received data is forced to stable storage.
+//   None      never; the OS flushes whenever it likes
+//   Periodic  FlushFileBuffers every PERIODIC_SYNC_BYTES and at the end
+//   Rename    write to <file>.part, flush at the end, then rename into place
+enum class SyncPolicy {
+    None,
+    Periodic,
+    Rename
+};
+
+constexpr size_t   WRITE_COALESCE_SIZE = 1024 * 1024;
+constexpr uint64_t PERIODIC_SYNC_BYTES = 64ULL * 1024 * 1024;
+constexpr uint64_t PREALLOCATE_MARGIN  = 1024ULL * 1024 * 1024;   // free space left to the rest of the system
+
+bool parseSyncPolicy(const std::string& name, SyncPolicy& out) noexcept;
+
+// Append-only output file for one transfer. Incoming data is coalesced into
+// WRITE_COALESCE_SIZE writes, so every write but the last starts and ends on
+// a block boundary regardless of the negotiated record size.
+class FileWriter {
+public:
+    // Whole blocks already on disk for path, found without opening or
+    // creating the file.
+    static uint64_t resumeBlockOf(const std::string& path, SyncPolicy policy) noexcept;
+
+    // Opens (or creates) the file and appends after resumeBlock whole blocks.
+    // Anything past them is dropped before the first write, so opening alone
+    // never modifies the file. Throws if fewer blocks are on disk.
+    FileWriter(const std::string& path, SyncPolicy policy, uint64_t resumeBlock);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    // Reserves disk space for the final size without moving end-of-file,
+    // leaving at least PREALLOCATE_MARGIN of the volume free. Call only after
+    // key exchange: size comes from the peer.
+    void preallocate(uint64_t size) noexcept;
+
+    void write(const uint8_t* data, size_t len);
+
+    // Flushes buffered data and applies the sync policy. Throws unless the
+    // file holds exactly expectedSize bytes; with Rename it then stays under
+    // its .part name for a later resume.
+    void commit(uint64_t expectedSize);
+
+private:
+    void trimTail();
+    void flushBuffer();
+    void sync();
+
+    std::string _path;
+    std::string _workPath;
+    SyncPolicy  _policy;
+    void*       _file;
+
+    std::vector<uint8_t> _buf;
+    uint64_t _offset;       // bytes on disk
+    uint64_t _unsynced;
+    bool     _trimmed;
+};
+
+}
+}
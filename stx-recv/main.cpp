@@ -3,14 +3,19 @@ extern "C" {
 }
 
 #include <iostream>
+#include <cstdlib>
 #include <fstream>
 #include <direct.h>
 #include <sys/stat.h>
 
 #include "../common/socket.h"
 #include "../common/crypto.h"
+#include "../common/keystore.h"
 #include "../common/transfer.h"
+#include "../common/handshake.h"
 #include "../common/common.h"
+#include "../common/chunkstore.h"
+#include "../common/writer.h"
 
 using namespace stx;
 
@@ -21,8 +26,29 @@ static void ensure_directory_exists(const std::string& path) {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 5 || std::string(argv[1]) != "--listen" || std::string(argv[3]) != "--out") {
-        std::cerr << "Usage: stx-recv --listen <port> --out <output_dir>\n";
+    io::SyncPolicy syncPolicy = io::SyncPolicy::None;
+    std::string    keyPath    = "../../../keys/recv_priv.pem";
+    uint64_t       storeLimit = dedup::DEFAULT_STORE_LIMIT;
+    bool           argsOk     = argc >= 5 && std::string(argv[1]) == "--listen" &&
+                                std::string(argv[3]) == "--out" && argc % 2 == 1;
+    for (int i = 5; argsOk && i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sync")
+            argsOk = io::parseSyncPolicy(argv[i + 1], syncPolicy);
+        else if (flag == "--key")
+            keyPath = argv[i + 1];
+        else if (flag == "--store-limit") {
+            char* end = nullptr;
+            unsigned long long mib = std::strtoull(argv[i + 1], &end, 10);
+            argsOk = end != argv[i + 1] && *end == '\0' && mib <= UINT64_MAX / (1024 * 1024);
+            storeLimit = mib * 1024 * 1024;
+        } else
+            argsOk = false;
+    }
+    if (!argsOk) {
+        std::cerr << "Usage: stx-recv --listen <port> --out <output_dir>"
+                     " [--sync none|periodic|rename] [--key <recv_priv.pem>]"
+                     " [--store-limit <MiB>]\n";
         return ExitCode::IO_ERROR;
     }
 
@@ -30,7 +56,13 @@ int main(int argc, char* argv[]) {
     std::string outdir = argv[4];
 
     net::initWinsock();
-    crypto::RSAKey myPriv("../../../keys/recv_priv.pem", true);
+    crypto::KeyStore keys(keyPath, "");
+    crypto::KeyStore::installReloadSignal();
+
+    ensure_directory_exists(outdir);
+    const std::string storeDir = outdir + "/.stx-chunks";
+    ensure_directory_exists(storeDir);
+    dedup::ChunkStore store(storeDir, storeLimit);
 
     net::SocketRAII server;
     server.bindAndListen(port);
@@ -40,41 +72,117 @@ int main(int argc, char* argv[]) {
         try {
             auto client = server.acceptClient();
             std::cout << "Client connected.\n";
+            if (keys.reloadIfRequested())
+                std::cout << "Reloaded keys from " << keyPath << "\n";
+            client.setRecvTimeout(SESSION_RECV_TIMEOUT_MS);
+
+            transfer::Handshake hello;
+            if (!transfer::recvHandshake(client.get(), hello))
+                throw std::runtime_error("Handshake receive failed");
+
+            transfer::FileMetadata meta = hello.metadata();
+            std::cout << "Metadata: file=" << meta.filename
+                        << " size=" << meta.filesize << "\n";
+
+            transfer::Capabilities chosen = transfer::Capabilities();
+            bool compatible = hello.version == transfer::PROTOCOL_VERSION &&
+                              transfer::negotiate(hello.caps, transfer::localCapabilities(), chosen);
+
+            std::string outPath = outdir + "/" + meta.filename;
+            const size_t recordLen = transfer::recordSize(chosen.recordSizes);
+
+            transfer::Handshake reply = hello;
+            reply.version            = transfer::PROTOCOL_VERSION;
+            reply.caps               = transfer::Capabilities();
+            reply.lastConfirmedBlock = 0;
+            if (!compatible) {
+                transfer::sendHandshake(client.get(), reply);
+                throw std::runtime_error("No common transfer mode with sender (version "
+                                         + std::to_string(hello.version) + ")");
+            }
+
+            // The output is only opened after key exchange; a file longer
+            // than the one announced cannot be resumed.
+            uint64_t lastBlock = io::FileWriter::resumeBlockOf(outPath, syncPolicy);
+            if (lastBlock * BLOCK_SIZE > meta.filesize)
+                lastBlock = 0;
+
+            reply.caps               = chosen;
+            reply.lastConfirmedBlock = lastBlock;
+            if (!transfer::sendHandshake(client.get(), reply))
+                throw std::runtime_error("Handshake reply failed");
 
             uint64_t keyLen = 0;
             if (!transfer::recvUInt64(client.get(), keyLen))
                 throw std::runtime_error("Failed to read key length");
+            if (keyLen == 0 || keyLen > MAX_WRAPPED_KEY_LEN)
+                throw std::runtime_error("Invalid key length " + std::to_string(keyLen));
 
-            std::vector<uint8_t> encryptedKey(keyLen);
+            std::vector<uint8_t> encryptedKey(static_cast<size_t>(keyLen));
             if (!transfer::recvAll(client.get(),
                                     reinterpret_cast<char*>(encryptedKey.data()),
-                                    keyLen))
+                                    encryptedKey.size()))
                 throw std::runtime_error("Failed to read key data");
 
-            auto sessionKey = crypto::rsaDecrypt(myPriv.get(), encryptedKey);
-
-            transfer::FileMetadata meta;
-            if (!transfer::recvMetadata(client.get(), meta))
-                throw std::runtime_error("Metadata receive failed");
-            std::cout << "Metadata: file=" << meta.filename
-                        << " size=" << meta.filesize << "\n";
-
-            ensure_directory_exists(outdir);
-            std::string outPath = outdir + "/" + meta.filename;
-            std::ofstream outfile(outPath, std::ios::binary | std::ios::app);
-            if (!outfile)
-                throw std::runtime_error("Cannot open " + outPath);
-
-            uint64_t lastBlock = uint64_t(outfile.tellp()) / BLOCK_SIZE;
-            transfer::sendUInt64(client.get(), lastBlock);
+            auto sessionKey = keys.unwrapSessionKey(encryptedKey);
+            io::FileWriter outfile(outPath, syncPolicy, lastBlock);
 
+            const uint64_t resumeOffset = lastBlock * BLOCK_SIZE;
+            const uint64_t remaining = meta.filesize - resumeOffset;
+            std::vector<dedup::ChunkRef> manifest;
+            std::vector<char> have;
             std::vector<uint8_t> block;
-            uint64_t count = lastBlock;
-            while (transfer::recvEncryptedBlock(client.get(), block, sessionKey)) {
-                outfile.write(reinterpret_cast<char*>(block.data()), block.size());
-                ++count;
+            std::vector<uint8_t> chunk;
+            uint64_t received = 0;
+            uint64_t chunks   = 0;
+            uint64_t reused   = 0;
+            for (;;) {
+                if (!transfer::recvChunkManifest(client.get(), manifest, received, remaining))
+                    throw std::runtime_error("Chunk manifest receive failed");
+                if (manifest.empty())
+                    break;
+
+                // Reserve space only after key exchange and a valid first manifest.
+                if (received == 0)
+                    outfile.preallocate(meta.filesize);
+
+                // Claim only chunks that still verify; a damaged one is dropped
+                // from the store and requested from the sender instead.
+                have.resize(manifest.size());
+                for (size_t i = 0; i < manifest.size(); ++i)
+                    have[i] = store.tryLoad(manifest[i].hash, chunk) ? 1 : 0;
+                if (!transfer::sendAll(client.get(), have.data(), have.size()))
+                    throw std::runtime_error("Failed to send chunk availability");
+
+                for (size_t i = 0; i < manifest.size(); ++i, ++chunks) {
+                    const auto& ref = manifest[i];
+                    if (have[i]) {
+                        store.load(ref.hash, chunk);
+                        outfile.write(chunk.data(), chunk.size());
+                        ++reused;
+                        continue;
+                    }
+
+                    chunk.clear();
+                    while (chunk.size() < ref.length) {
+                        if (!transfer::recvEncryptedBlock(client.get(), block, sessionKey, recordLen))
+                            throw std::runtime_error("Connection lost in chunk " + std::to_string(chunks));
+                        chunk.insert(chunk.end(), block.begin(), block.end());
+                    }
+                    if (chunk.size() != ref.length || crypto::sha256(chunk.data(), chunk.size()) != ref.hash)
+                        throw std::runtime_error("Chunk " + std::to_string(chunks) + " failed verification");
+
+                    outfile.write(chunk.data(), chunk.size());
+                    store.put(ref.hash, chunk);
+                }
+                received = manifest.back().offset + manifest.back().length;
             }
-            std::cout << "Received " << count << " blocks\n";
+            outfile.commit(meta.filesize);
+            if (!transfer::sendUInt64(client.get(), transfer::TRANSFER_COMMITTED))
+                throw std::runtime_error("Failed to confirm transfer");
+
+            std::cout << "Received " << chunks << " chunks ("
+                      << reused << " from local store)\n";
         }
         catch (const std::exception& ex) {
             log_error(ex.what());
@@ -5,19 +5,23 @@ extern "C" {
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 
 #include "../common/socket.h"
 #include "../common/crypto.h"
+#include "../common/keystore.h"
 #include "../common/transfer.h"
+#include "../common/handshake.h"
 #include "../common/common.h"
 
 using namespace stx;
 
 int main(int argc, char* argv[]) {
-    if (argc < 6 || std::string(argv[4]) != "--key") {
-        std::cerr << "Usage: stx-send <host> <port> <file> --key <privkey.pem>\n";
+    if (argc < 6 || std::string(argv[4]) != "--key" ||
+        (argc >= 7 && (argc != 8 || std::string(argv[6]) != "--peer"))) {
+        std::cerr << "Usage: stx-send <host> <port> <file> --key <privkey.pem> [--peer <recv_pub.pem>]\n";
         return ExitCode::IO_ERROR;
     }
 
@@ -25,6 +29,7 @@ int main(int argc, char* argv[]) {
     const uint16_t    port      = static_cast<uint16_t>(std::stoi(argv[2]));
     const std::string filepath  = argv[3];
     const std::string privkey   = argv[5];
+    const std::string peerkey   = argc >= 8 ? argv[7] : "../../../keys/recv_pub.pem";
 
     std::ifstream infile(filepath, std::ios::binary);
     if (!infile) {
@@ -42,54 +47,101 @@ int main(int argc, char* argv[]) {
 
     const uint64_t totalBlocks = (filesize + BLOCK_SIZE - 1) / BLOCK_SIZE;
     uint64_t sentBlocks = 0;
+    bool     committed  = false;
 
     net::initWinsock();
-    while (sentBlocks < totalBlocks) {
+    crypto::KeyStore keys(privkey, peerkey);
+    while (!committed) {
         try {
             net::SocketRAII sock;
             sock.connectTo(host, port);
 
-            crypto::RSAKey    myPriv(privkey, true);
-            crypto::RSAKey    peerPub("../../../keys/recv_pub.pem", false);
-            auto              sessionKey   = crypto::generateSessionKey();
-            auto              encryptedKey = crypto::rsaEncrypt(peerPub.get(), sessionKey);
-
-            transfer::sendUInt64(sock.get(), encryptedKey.size());
-            send(sock.get(),
-                    reinterpret_cast<const char*>(encryptedKey.data()),
-                    static_cast<int>(encryptedKey.size()),
-                    0);
-
             transfer::FileMetadata meta;
             meta.filename           = filepath.substr(filepath.find_last_of("/\\") + 1);
             meta.filesize           = filesize;
             meta.lastConfirmedBlock = 0;
-            transfer::sendMetadata(sock.get(), meta);
-
-            uint64_t resumeFrom = 0;
-            if (!transfer::recvUInt64(sock.get(), resumeFrom))
-                throw std::runtime_error("Failed to receive resume offset");
-            sentBlocks = resumeFrom;
-            infile.clear();
-            infile.seekg(sentBlocks * BLOCK_SIZE);
 
-            std::vector<uint8_t> buf(BLOCK_SIZE);
-            while (!infile.eof()) {
-                infile.read(reinterpret_cast<char*>(buf.data()), BLOCK_SIZE);
-                std::streamsize r = infile.gcount();
-                if (r <= 0) break;
-                buf.resize(static_cast<size_t>(r));
+            transfer::Handshake hello;
+            if (!transfer::makeHandshake(meta, transfer::localCapabilities(), hello))
+                throw std::runtime_error("Unsupported file name: " + meta.filename);
+            if (!transfer::sendHandshake(sock.get(), hello))
+                throw std::runtime_error("Failed to send handshake");
+
+            transfer::Handshake reply;
+            if (!transfer::recvHandshake(sock.get(), reply))
+                throw std::runtime_error("Failed to receive handshake reply");
+            const size_t recordLen = transfer::recordSize(reply.caps.recordSizes);
+            if (reply.version != transfer::PROTOCOL_VERSION || recordLen == 0 ||
+                reply.caps.ciphers != transfer::CIPHER_AES256_CBC ||
+                reply.caps.hashes != transfer::HASH_SHA256)
+                throw std::runtime_error("Receiver refused all offered transfer modes");
+            const uint64_t resumeFrom = reply.lastConfirmedBlock;
+
+            auto sessionKey   = crypto::generateSessionKey();
+            auto encryptedKey = keys.wrapSessionKey(sessionKey);
+
+            if (!transfer::sendUInt64(sock.get(), encryptedKey.size()) ||
+                !transfer::sendAll(sock.get(),
+                                   reinterpret_cast<const char*>(encryptedKey.data()),
+                                   encryptedKey.size()))
+                throw std::runtime_error("Failed to send session key");
 
-                if (!transfer::sendEncryptedBlock(sock.get(), buf, sessionKey))
-                    throw std::runtime_error("Failed at block " + std::to_string(sentBlocks));
+            sentBlocks = resumeFrom;
 
-                ++sentBlocks;
-                buf.resize(BLOCK_SIZE);
+            // Announce the file a window of chunks at a time and send only the
+            // chunks the receiver's store does not already hold.
+            std::vector<char> have;
+            std::vector<uint8_t> chunk;
+            std::vector<uint8_t> buf;
+            uint64_t next   = sentBlocks * BLOCK_SIZE;
+            uint64_t total  = 0;
+            uint64_t reused = 0;
+            for (;;) {
+                auto chunks = dedup::chunkStream(infile, next, filesize, MANIFEST_WINDOW);
+                if (!transfer::sendChunkManifest(sock.get(), chunks))
+                    throw std::runtime_error("Failed to send chunk manifest");
+                if (chunks.empty())
+                    break;
+
+                have.resize(chunks.size());
+                if (!transfer::recvAll(sock.get(), have.data(), have.size()))
+                    throw std::runtime_error("Failed to receive chunk availability");
+
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    const auto& ref = chunks[i];
+                    if (have[i]) {
+                        ++reused;
+                        continue;
+                    }
+
+                    chunk.resize(static_cast<size_t>(ref.length));
+                    infile.clear();
+                    infile.seekg(static_cast<std::streamoff>(ref.offset));
+                    infile.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+                    if (infile.gcount() != static_cast<std::streamsize>(chunk.size()))
+                        throw std::runtime_error("Short read at offset " + std::to_string(ref.offset));
+
+                    for (size_t off = 0; off < chunk.size(); off += recordLen) {
+                        size_t n = std::min<size_t>(recordLen, chunk.size() - off);
+                        buf.assign(chunk.begin() + off, chunk.begin() + off + n);
+                        if (!transfer::sendEncryptedBlock(sock.get(), buf, sessionKey))
+                            throw std::runtime_error("Failed at block " + std::to_string(sentBlocks));
+                    }
+                    sentBlocks = (ref.offset + ref.length) / BLOCK_SIZE;
+                }
+                next   = chunks.back().offset + chunks.back().length;
+                total += chunks.size();
             }
-
-            transfer::sendUInt64(sock.get(), 0);
             shutdown(sock.get(), SD_SEND);
 
+            // Done only once the receiver has the whole file on disk.
+            uint64_t status = 0;
+            if (!transfer::recvUInt64(sock.get(), status) || status != transfer::TRANSFER_COMMITTED)
+                throw std::runtime_error("Receiver did not confirm the transfer");
+            committed  = true;
+            sentBlocks = totalBlocks;
+            std::cout << "Deduplicated " << reused << " / " << total << " chunks\n";
+
             std::cout << "Transfer complete: " << sentBlocks << " / " << totalBlocks << " blocks\n";
             break;
         }
@@ -0,0 +1,399 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/socket.h"
+#include "../common/crypto.h"
+#include "../common/keystore.h"
+#include "../common/transfer.h"
+#include "../common/handshake.h"
+#include "../common/common.h"
+
+#include <windows.h>
+#include <psapi.h>
+
+#pragma comment(lib, "Psapi.lib")
+
+using namespace stx;
+
+// Opens many concurrent sessions against a local stx-recv, mixing well-formed
+// transfers with malformed ones, and reports throughput and the receiver's
+// memory high-water mark.
+
+namespace {
+
+struct Options {
+    std::string host;
+    uint16_t    port        = 0;
+    uint64_t    sessions    = 1000;
+    unsigned    concurrency = 64;
+    size_t      payload     = 256 * 1024;
+    unsigned    abusePct    = 50;
+    DWORD       recvPid     = 0;
+    std::string pubKey      = "../../../keys/recv_pub.pem";
+};
+
+struct Stats {
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> queued{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+enum class Abuse {
+    HugeFilenameLen,
+    Garbage,
+    HugeKeyLen,
+    HugeManifest,
+    HugeRecord,
+    Truncated,
+    Count
+};
+
+enum class Verdict {
+    Dropped,
+    NotDropped,
+    Queued      // never answered, but the receiver may not have reached it yet
+};
+
+const char* abuseName(Abuse a) {
+    switch (a) {
+    case Abuse::HugeFilenameLen: return "huge filename length";
+    case Abuse::Garbage:         return "garbage handshake";
+    case Abuse::HugeKeyLen:      return "huge key length";
+    case Abuse::HugeManifest:    return "huge manifest count";
+    case Abuse::HugeRecord:      return "huge record length";
+    case Abuse::Truncated:       return "truncated session";
+    default:                     return "?";
+    }
+}
+
+std::vector<uint8_t> random_payload(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint8_t> data(n);
+    for (size_t i = 0; i < n; i += 8) {
+        uint64_t v = rng();
+        for (size_t k = 0; k < 8 && i + k < n; ++k)
+            data[i + k] = uint8_t(v >> (8 * k));
+    }
+    return data;
+}
+
+// Handshake + session key; returns the negotiated record size (0 on refusal).
+size_t open_session(net::SocketRAII& sock, const Options& opt, const crypto::KeyStore& keys,
+                    const std::string& name, uint64_t size, uint64_t& resumeFrom,
+                    std::vector<uint8_t>& sessionKey) {
+    sock.connectTo(opt.host, opt.port);
+
+    transfer::FileMetadata meta;
+    meta.filename           = name;
+    meta.filesize           = size;
+    meta.lastConfirmedBlock = 0;
+
+    transfer::Handshake hello, reply;
+    if (!transfer::makeHandshake(meta, transfer::localCapabilities(), hello) ||
+        !transfer::sendHandshake(sock.get(), hello) ||
+        !transfer::recvHandshake(sock.get(), reply))
+        return 0;
+    resumeFrom = reply.lastConfirmedBlock;
+
+    sessionKey = crypto::generateSessionKey();
+    auto encryptedKey = keys.wrapSessionKey(sessionKey);
+    if (!transfer::sendUInt64(sock.get(), encryptedKey.size()) ||
+        !transfer::sendAll(sock.get(), reinterpret_cast<const char*>(encryptedKey.data()), encryptedKey.size()))
+        return 0;
+
+    return transfer::recordSize(reply.caps.recordSizes);
+}
+
+bool run_valid(const Options& opt, const crypto::KeyStore& keys, const std::string& name,
+               const std::vector<uint8_t>& payload, Stats& stats) {
+    net::SocketRAII sock;
+    uint64_t resumeFrom = 0;
+    std::vector<uint8_t> key;
+    size_t recordLen = open_session(sock, opt, keys, name, payload.size(), resumeFrom, key);
+    if (recordLen == 0)
+        return false;
+
+    std::istringstream in(std::string(payload.begin(), payload.end()));
+    std::vector<char> have;
+    std::vector<uint8_t> buf;
+    uint64_t next = resumeFrom * BLOCK_SIZE;
+    for (;;) {
+        auto chunks = dedup::chunkStream(in, next, payload.size(), MANIFEST_WINDOW);
+        if (!transfer::sendChunkManifest(sock.get(), chunks))
+            return false;
+        if (chunks.empty())
+            break;
+
+        have.resize(chunks.size());
+        if (!transfer::recvAll(sock.get(), have.data(), have.size()))
+            return false;
+
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (have[i])
+                continue;
+            for (uint64_t off = 0; off < chunks[i].length; off += recordLen) {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(recordLen, chunks[i].length - off));
+                auto first = payload.begin() + static_cast<std::ptrdiff_t>(chunks[i].offset + off);
+                buf.assign(first, first + static_cast<std::ptrdiff_t>(n));
+                if (!transfer::sendEncryptedBlock(sock.get(), buf, key))
+                    return false;
+                stats.bytes += n;
+            }
+        }
+        next = chunks.back().offset + chunks.back().length;
+    }
+
+    shutdown(sock.get(), SD_SEND);
+    uint64_t status = 0;
+    return transfer::recvUInt64(sock.get(), status) && status == transfer::TRANSFER_COMMITTED;
+}
+
+// Sends one malformed session and waits for the receiver to close it. stx-recv
+// serves one session at a time, so a session only counts as NOT dropped if the
+// receiver has answered it (engaged) and then kept it open past its timeout.
+Verdict run_abuse(const Options& opt, const crypto::KeyStore& keys, Abuse kind, const std::string& name) {
+    net::SocketRAII sock;
+    uint64_t resumeFrom = 0;
+    std::vector<uint8_t> key;
+    bool engaged = false;
+
+    switch (kind) {
+    case Abuse::HugeFilenameLen: {
+        sock.connectTo(opt.host, opt.port);
+        uint8_t frame[transfer::HANDSHAKE_FIXED_SIZE] = {};
+        frame[0] = 'S'; frame[1] = 'T'; frame[2] = 'X'; frame[3] = '1';
+        frame[40] = 0xFF; frame[41] = 0xFF;
+        transfer::sendAll(sock.get(), reinterpret_cast<const char*>(frame), sizeof(frame));
+        break;
+    }
+    case Abuse::Garbage: {
+        sock.connectTo(opt.host, opt.port);
+        auto junk = random_payload(4096, std::hash<std::string>()(name));
+        transfer::sendAll(sock.get(), reinterpret_cast<const char*>(junk.data()), junk.size());
+        break;
+    }
+    case Abuse::HugeKeyLen: {
+        sock.connectTo(opt.host, opt.port);
+        transfer::FileMetadata meta;
+        meta.filename = name;
+        meta.filesize = 1;
+        meta.lastConfirmedBlock = 0;
+        transfer::Handshake hello, reply;
+        engaged = transfer::makeHandshake(meta, transfer::localCapabilities(), hello) &&
+                  transfer::sendHandshake(sock.get(), hello) &&
+                  transfer::recvHandshake(sock.get(), reply);
+        if (engaged)
+            transfer::sendUInt64(sock.get(), uint64_t(1) << 40);
+        break;
+    }
+    case Abuse::HugeManifest:
+        engaged = open_session(sock, opt, keys, name, 1, resumeFrom, key) != 0;
+        if (engaged)
+            transfer::sendUInt64(sock.get(), uint64_t(1) << 50);
+        break;
+    case Abuse::HugeRecord:
+        engaged = open_session(sock, opt, keys, name, 1, resumeFrom, key) != 0;
+        if (engaged) {
+            std::vector<dedup::ChunkRef> one(1);
+            one[0].offset = 0;
+            one[0].length = 1;
+            one[0].hash.fill(0xAB);
+            std::vector<char> have(1);
+            std::vector<uint8_t> iv(AES_IV_LEN, 0);
+            if (transfer::sendChunkManifest(sock.get(), one) &&
+                transfer::recvAll(sock.get(), have.data(), have.size()) &&
+                transfer::sendIV(sock.get(), iv))
+                transfer::sendUInt64(sock.get(), uint64_t(1) << 40);
+        }
+        break;
+    case Abuse::Truncated: {
+        // A valid handshake, then silence: the receiver must time out and close.
+        sock.connectTo(opt.host, opt.port);
+        transfer::FileMetadata meta;
+        meta.filename = name;
+        meta.filesize = 1;
+        meta.lastConfirmedBlock = 0;
+        transfer::Handshake hello, reply;
+        engaged = transfer::makeHandshake(meta, transfer::localCapabilities(), hello) &&
+                  transfer::sendHandshake(sock.get(), hello) &&
+                  transfer::recvHandshake(sock.get(), reply);
+        break;
+    }
+    default:
+        return Verdict::NotDropped;
+    }
+
+    // A hardened receiver drops the session instead of waiting for more data.
+    // Frames it rejects without replying may still be queued behind every
+    // other connection, each of which can hold the receiver for a full timeout.
+    uint64_t waitMs = SESSION_RECV_TIMEOUT_MS + 5000;
+    if (!engaged)
+        waitMs += uint64_t(opt.concurrency) * SESSION_RECV_TIMEOUT_MS;
+    sock.setRecvTimeout(static_cast<uint32_t>(std::min<uint64_t>(waitMs, UINT32_MAX)));
+    char tmp[256];
+    for (;;) {
+        int r = recv(sock.get(), tmp, sizeof(tmp), 0);
+        if (r == 0)
+            return Verdict::Dropped;
+        if (r == SOCKET_ERROR) {
+            if (WSAGetLastError() != WSAETIMEDOUT)
+                return Verdict::Dropped;
+            return engaged ? Verdict::NotDropped : Verdict::Queued;
+        }
+    }
+}
+
+struct ProcessMemory {
+    size_t peakWorkingSet = 0;
+    size_t peakCommit     = 0;
+};
+
+bool query_memory(DWORD pid, ProcessMemory& out) {
+    HANDLE h = pid ? OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, FALSE, pid)
+                   : GetCurrentProcess();
+    if (!h)
+        return false;
+
+    PROCESS_MEMORY_COUNTERS pmc;
+    BOOL ok = GetProcessMemoryInfo(h, &pmc, sizeof(pmc));
+    if (pid)
+        CloseHandle(h);
+    if (!ok)
+        return false;
+
+    out.peakWorkingSet = pmc.PeakWorkingSetSize;
+    out.peakCommit     = pmc.PeakPagefileUsage;
+    return true;
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+    if (argc < 3)
+        return false;
+    opt.host = argv[1];
+    opt.port = static_cast<uint16_t>(std::stoi(argv[2]));
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string val  = argv[i + 1];
+        if (flag == "--sessions")         opt.sessions    = std::stoull(val);
+        else if (flag == "--concurrency") opt.concurrency = static_cast<unsigned>(std::stoul(val));
+        else if (flag == "--size")        opt.payload     = static_cast<size_t>(std::stoull(val));
+        else if (flag == "--abuse")       opt.abusePct    = static_cast<unsigned>(std::stoul(val));
+        else if (flag == "--recv-pid")    opt.recvPid     = static_cast<DWORD>(std::stoul(val));
+        else if (flag == "--pub")         opt.pubKey      = val;
+        else return false;
+    }
+    return opt.concurrency > 0 && opt.abusePct <= 100;
+}
+
+double mib(uint64_t bytes) {
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        std::cerr << "Usage: stx-stress <host> <port> [--sessions <n>] [--concurrency <c>]\n"
+                     "                  [--size <bytes>] [--abuse <percent>] [--recv-pid <pid>]\n"
+                     "                  [--pub <recv_pub.pem>]\n";
+        return ExitCode::IO_ERROR;
+    }
+
+    net::initWinsock();
+    crypto::KeyStore keys("", opt.pubKey);
+
+    ProcessMemory before;
+    if (opt.recvPid && !query_memory(opt.recvPid, before))
+        log_error("Cannot query memory of pid " + std::to_string(opt.recvPid));
+
+    Stats stats;
+    std::atomic<uint64_t> next{0};
+    std::vector<uint64_t> abuseSeen(static_cast<size_t>(Abuse::Count));
+    std::mutex abuseLock;
+    const uint64_t runId = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+
+    auto worker = [&]() {
+        for (uint64_t n = next++; n < opt.sessions; n = next++) {
+            std::string name = "stress-" + std::to_string(runId) + "-" + std::to_string(n) + ".bin";
+            bool abusive = (n % 100) < opt.abusePct;
+            try {
+                if (abusive) {
+                    Abuse kind = static_cast<Abuse>(n % static_cast<uint64_t>(Abuse::Count));
+                    {
+                        std::lock_guard<std::mutex> g(abuseLock);
+                        ++abuseSeen[static_cast<size_t>(kind)];
+                    }
+                    switch (run_abuse(opt, keys, kind, name)) {
+                    case Verdict::Dropped:    ++stats.rejected; break;
+                    case Verdict::NotDropped: ++stats.accepted; break;
+                    case Verdict::Queued:     ++stats.queued;   break;
+                    }
+                }
+                else {
+                    auto payload = random_payload(opt.payload, runId ^ n);
+                    if (run_valid(opt, keys, name, payload, stats))
+                        ++stats.ok;
+                    else
+                        ++stats.failed;
+                }
+            }
+            catch (const std::exception&) {
+                ++stats.failed;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < opt.concurrency; ++i)
+        threads.emplace_back(worker);
+    for (auto& t : threads)
+        t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Sessions:          " << opt.sessions << " (" << opt.concurrency << " concurrent)\n"
+              << "Valid completed:   " << stats.ok << "\n"
+              << "Failed:            " << stats.failed << "\n"
+              << "Abuse dropped:     " << stats.rejected << "\n"
+              << "Abuse NOT dropped: " << stats.accepted << "\n"
+              << "Abuse unanswered:  " << stats.queued << " (never reached by the receiver)\n";
+    for (size_t i = 0; i < abuseSeen.size(); ++i)
+        if (abuseSeen[i])
+            std::cout << "  " << abuseName(static_cast<Abuse>(i)) << ": " << abuseSeen[i] << "\n";
+
+    std::cout << "Elapsed:           " << secs << " s\n"
+              << "Throughput:        " << (secs > 0 ? mib(stats.bytes) / secs : 0.0) << " MiB/s, "
+              << (secs > 0 ? double(stats.ok + stats.rejected) / secs : 0.0) << " sessions/s\n";
+
+    ProcessMemory self, after;
+    if (query_memory(0, self))
+        std::cout << "Stress peak WS:    " << mib(self.peakWorkingSet) << " MiB\n";
+    if (opt.recvPid && query_memory(opt.recvPid, after))
+        std::cout << "stx-recv peak WS:  " << mib(after.peakWorkingSet) << " MiB (was "
+                  << mib(before.peakWorkingSet) << ")\n"
+                  << "stx-recv peak commit: " << mib(after.peakCommit) << " MiB (was "
+                  << mib(before.peakCommit) << ")\n";
+
+    net::cleanupWinsock();
+    return stats.accepted == 0 ? ExitCode::SUCCESS : ExitCode::NETWORK_ERROR;
+}
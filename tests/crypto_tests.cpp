@@ -3,6 +3,7 @@ extern "C" {
 }
 
 #include "../common/crypto.h"
+#include "../common/keystore.h"
 #include <cassert>
 #include <iostream>
 #include <vector>
@@ -63,11 +64,28 @@ void test_session_key_generation() {
     std::cout << "[PASS] Session key generation\n";
 }
 
+void test_keystore_roundtrip() {
+    KeyStore store("../../keys/recv_priv.pem", "../../keys/recv_pub.pem");
+    auto key = generateSessionKey();
+
+    auto wrapped   = store.wrapSessionKey(key);
+    auto unwrapped = store.unwrapSessionKey(wrapped);
+    assert(unwrapped == key);
+
+    // Contexts built before a reload must not be reused after it.
+    store.reload();
+    auto rewrapped   = store.wrapSessionKey(key);
+    auto reunwrapped = store.unwrapSessionKey(rewrapped);
+    assert(reunwrapped == key);
+    std::cout << "[PASS] KeyStore wrap/unwrap and reload\n";
+}
+
 int main() {
     try {
         test_session_key_generation();
         test_aes_encrypt_decrypt();
         test_rsa_encrypt_decrypt();
+        test_keystore_roundtrip();
     } catch (const std::exception& ex) {
         std::cerr << "[FAIL] Exception: " << ex.what() << "\n";
         return 1;
@@ -0,0 +1,278 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include "../common/chunker.h"
+#include "../common/chunkstore.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <direct.h>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace stx::dedup;
+
+static std::string random_bytes(size_t n, unsigned seed) {
+    std::string s(n, '\0');
+    std::srand(seed);
+    for (auto& c : s)
+        c = static_cast<char>(std::rand() & 0xFF);
+    return s;
+}
+
+void test_chunks_cover_input() {
+    std::string data = random_bytes(1024 * 1024, 1);
+    std::istringstream in(data);
+    auto chunks = chunkStream(in, 0, data.size());
+
+    uint64_t expected = 0;
+    for (const auto& c : chunks) {
+        assert(c.offset == expected);
+        assert(c.length <= CHUNK_MAX_SIZE);
+        expected += c.length;
+    }
+    assert(expected == data.size());
+    std::cout << "[PASS] Chunks cover input (" << chunks.size() << " chunks)\n";
+}
+
+void test_chunks_survive_insertion() {
+    std::string data = random_bytes(1024 * 1024, 2);
+    std::string shifted = "inserted prefix" + data;
+
+    std::istringstream a(data), b(shifted);
+    auto ca = chunkStream(a, 0, data.size());
+    auto cb = chunkStream(b, 0, shifted.size());
+
+    std::set<std::string> hashes;
+    for (const auto& c : ca)
+        hashes.insert(std::string(c.hash.begin(), c.hash.end()));
+
+    size_t shared = 0;
+    for (const auto& c : cb)
+        shared += hashes.count(std::string(c.hash.begin(), c.hash.end()));
+
+    // Only the chunk containing the insertion may differ.
+    if (shared + 2 < ca.size()) {
+        std::cerr << "[FAIL] Only " << shared << " of " << ca.size() << " chunks reused after insertion\n";
+        std::exit(1);
+    }
+    std::cout << "[PASS] Chunk boundaries survive insertion\n";
+}
+
+void test_windowed_chunking_matches_single_pass() {
+    std::string data = random_bytes(1024 * 1024, 3);
+    std::istringstream in(data);
+    auto whole = chunkStream(in, 0, data.size());
+
+    std::vector<ChunkRef> windowed;
+    uint64_t next = 0;
+    for (;;) {
+        auto window = chunkStream(in, next, data.size(), 7);
+        if (window.empty())
+            break;
+        assert(window.size() <= 7);
+        windowed.insert(windowed.end(), window.begin(), window.end());
+        next = window.back().offset + window.back().length;
+    }
+
+    assert(windowed.size() == whole.size());
+    for (size_t i = 0; i < whole.size(); ++i) {
+        assert(windowed[i].offset == whole[i].offset);
+        assert(windowed[i].hash == whole[i].hash);
+    }
+    std::cout << "[PASS] Windowed chunking matches a single pass\n";
+}
+
+static const std::string STORE_DIR = "chunkstore_test";
+
+static void remove_store_dir() {
+    std::remove((STORE_DIR + "/index.bin").c_str());
+    std::remove((STORE_DIR + "/pack.bin").c_str());
+    _rmdir(STORE_DIR.c_str());
+}
+
+static void reset_store_dir() {
+    remove_store_dir();
+    _mkdir(STORE_DIR.c_str());
+}
+
+static uint64_t file_size(const std::string& path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return f ? static_cast<uint64_t>(f.tellg()) : 0;
+}
+
+static void patch_byte(const std::string& path, uint64_t offset, char value) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(static_cast<std::streamoff>(offset));
+    f.put(value);
+}
+
+// Small distinct chunks: the store does not care about chunk sizes.
+static std::vector<uint8_t> small_chunk(uint32_t i) {
+    std::vector<uint8_t> d(12, 0x5A);
+    for (int b = 0; b < 4; ++b)
+        d[b] = static_cast<uint8_t>(i >> (8 * b));
+    return d;
+}
+
+static stx::crypto::Sha256Digest hash_of(const std::vector<uint8_t>& d) {
+    return stx::crypto::sha256(d.data(), d.size());
+}
+
+void test_chunkstore_roundtrip() {
+    reset_store_dir();
+    ChunkStore store(STORE_DIR);
+
+    std::string data = random_bytes(20000, 4);
+    std::vector<uint8_t> chunk(data.begin(), data.end());
+    auto h = hash_of(chunk);
+    assert(!store.contains(h));
+
+    store.put(h, chunk);
+    store.put(h, chunk);
+    assert(store.contains(h));
+    assert(store.size() == 1);
+    uint64_t packBytes = file_size(STORE_DIR + "/pack.bin");
+    assert(packBytes == chunk.size());
+    (void)packBytes;
+
+    std::vector<uint8_t> out;
+    store.load(h, out);
+    assert(out == chunk);
+    std::cout << "[PASS] Chunk store put/load round trip\n";
+}
+
+void test_chunkstore_grows_and_reopens() {
+    reset_store_dir();
+    const uint32_t n = 60000;            // past 3/4 of the initial 65536 slots
+    {
+        ChunkStore store(STORE_DIR);
+        for (uint32_t i = 0; i < n; ++i) {
+            auto d = small_chunk(i);
+            store.put(hash_of(d), d);
+        }
+        assert(store.size() == n);
+    }
+    uint64_t indexBytes = file_size(STORE_DIR + "/index.bin");
+    assert(indexBytes == 32 + (uint64_t(1) << 17) * 48);
+    (void)indexBytes;
+
+    ChunkStore reopened(STORE_DIR);
+    assert(reopened.size() == n);
+    std::vector<uint8_t> out;
+    for (uint32_t i = 0; i < n; i += 997) {
+        auto d = small_chunk(i);
+        reopened.load(hash_of(d), out);
+        assert(out == d);
+    }
+    auto absent = small_chunk(n);
+    assert(!reopened.contains(hash_of(absent)));
+    (void)absent;
+    std::cout << "[PASS] Chunk store grows and reopens\n";
+}
+
+void test_chunkstore_resets_damaged_index() {
+    reset_store_dir();
+    auto d = small_chunk(1);
+    {
+        ChunkStore store(STORE_DIR);
+        store.put(hash_of(d), d);
+    }
+    patch_byte(STORE_DIR + "/index.bin", 0, 'X');
+
+    ChunkStore store(STORE_DIR);
+    assert(store.size() == 0);
+    assert(!store.contains(hash_of(d)));
+    uint64_t packBytes = file_size(STORE_DIR + "/pack.bin");
+    assert(packBytes == 0);
+    (void)packBytes;
+    std::cout << "[PASS] Chunk store resets a damaged index\n";
+}
+
+void test_chunkstore_drops_corrupt_chunks() {
+    reset_store_dir();
+    ChunkStore store(STORE_DIR);
+    const uint32_t n = 40000;            // dense enough for long probe runs
+    std::vector<stx::crypto::Sha256Digest> hashes;
+    for (uint32_t i = 0; i < n; ++i) {
+        auto d = small_chunk(i);
+        hashes.push_back(hash_of(d));
+        store.put(hashes.back(), d);
+    }
+    for (uint32_t i = 0; i < n; i += 101)
+        patch_byte(STORE_DIR + "/pack.bin", uint64_t(i) * 12 + 4, 0);
+
+    std::vector<uint8_t> out;
+    uint32_t dropped = 0;
+    for (uint32_t i = 0; i < n; i += 101) {
+        try {
+            store.load(hashes[i], out);
+        }
+        catch (const std::runtime_error&) {
+            ++dropped;
+        }
+        assert(!store.contains(hashes[i]));
+    }
+    assert(dropped == (n + 100) / 101);
+    assert(store.size() == n - dropped);
+    (void)dropped;
+
+    // Entries that probed past a dropped slot must still be reachable.
+    for (uint32_t i = 0; i < n; ++i) {
+        if (i % 101 == 0)
+            continue;
+        store.load(hashes[i], out);
+        assert(out == small_chunk(i));
+    }
+    std::cout << "[PASS] Chunk store drops corrupt chunks\n";
+}
+
+void test_chunkstore_respects_size_limit() {
+    reset_store_dir();
+    {
+        ChunkStore store(STORE_DIR, 12 * 10);
+        for (uint32_t i = 0; i < 20; ++i) {
+            auto d = small_chunk(i);
+            store.put(hash_of(d), d);
+        }
+        assert(store.size() == 10);
+        assert(!store.contains(hash_of(small_chunk(10))));
+    }
+
+    // The limit also counts what an earlier run left in the pack.
+    ChunkStore reopened(STORE_DIR, 12 * 11);
+    auto extra = small_chunk(30);
+    auto over = small_chunk(31);
+    reopened.put(hash_of(extra), extra);
+    reopened.put(hash_of(over), over);
+    assert(reopened.contains(hash_of(extra)));
+    assert(!reopened.contains(hash_of(over)));
+    uint64_t packBytes = file_size(STORE_DIR + "/pack.bin");
+    assert(packBytes == 12 * 11);
+    (void)packBytes;
+    std::cout << "[PASS] Chunk store respects its size limit\n";
+}
+
+int main() {
+    try {
+        test_chunks_cover_input();
+        test_chunks_survive_insertion();
+        test_windowed_chunking_matches_single_pass();
+        test_chunkstore_roundtrip();
+        test_chunkstore_grows_and_reopens();
+        test_chunkstore_resets_damaged_index();
+        test_chunkstore_drops_corrupt_chunks();
+        test_chunkstore_respects_size_limit();
+        remove_store_dir();
+    } catch (const std::exception& ex) {
+        std::cerr << "[FAIL] Exception: " << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
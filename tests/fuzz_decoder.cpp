@@ -0,0 +1,94 @@
+// libFuzzer target for the peer-facing decoders (configure with -DSTX_BUILD_FUZZERS=ON).
+//
+// The first input byte selects the decoder, the rest is fed to it as wire bytes:
+//   % 3 == 0 -> handshake frame + capability negotiation
+//   % 3 == 1 -> stream of encrypted records, decrypted with a fixed session key
+//   % 3 == 2 -> dedup manifest entries for a file size taken from the input
+
+#include "../common/handshake.h"
+#include "../common/transfer.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+using namespace stx;
+
+static void fuzz_handshake(const uint8_t* data, size_t size) {
+    transfer::Handshake hs;
+    if (!transfer::decodeHandshake(data, size, hs))
+        return;
+
+    transfer::Capabilities chosen;
+    if (transfer::negotiate(hs.caps, transfer::localCapabilities(), chosen))
+        (void)transfer::recordSize(chosen.recordSizes);
+
+    // Anything that decodes must re-encode to the same bytes.
+    uint8_t buf[transfer::HANDSHAKE_MAX_SIZE];
+    size_t len = transfer::encodeHandshake(hs, buf, sizeof(buf));
+    if (len != size)
+        std::abort();
+}
+
+static void fuzz_records(const uint8_t* data, size_t size) {
+    static const std::vector<uint8_t> key(32, 0x5A);
+
+    while (size > 0) {
+        transfer::RecordView rec;
+        size_t used = transfer::decodeRecord(data, size, MAX_RECORD_SIZE, rec);
+        if (used == 0 || used > size)
+            return;
+
+        std::vector<uint8_t> iv(rec.iv, rec.iv + AES_IV_LEN);
+        std::vector<uint8_t> enc(rec.ciphertext, rec.ciphertext + rec.ciphertextLen);
+        try {
+            auto plain = crypto::aesDecrypt(enc, key, iv);
+            if (plain.size() > MAX_RECORD_SIZE)
+                std::abort();
+        }
+        catch (const std::runtime_error&) {
+            // Bad padding is expected for random ciphertext.
+        }
+
+        data += used;
+        size -= used;
+    }
+}
+
+static void fuzz_manifest(const uint8_t* data, size_t size) {
+    if (size < sizeof(uint64_t))
+        return;
+
+    uint64_t expected = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i)
+        expected = (expected << 8) | data[i];
+    data += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+
+    std::vector<dedup::ChunkRef> chunks;
+    if (!transfer::decodeChunkManifest(data, size, 0, expected, chunks))
+        return;
+
+    // Accepted entries must be contiguous, in range and one per wire entry.
+    uint64_t offset = 0;
+    for (const auto& c : chunks) {
+        if (c.offset != offset || c.length == 0 || c.length > dedup::CHUNK_MAX_SIZE)
+            std::abort();
+        offset += c.length;
+    }
+    if (offset > expected || chunks.size() != size / transfer::MANIFEST_ENTRY_SIZE)
+        std::abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size == 0)
+        return 0;
+
+    switch (data[0] % 3) {
+    case 0:  fuzz_handshake(data + 1, size - 1); break;
+    case 1:  fuzz_records(data + 1, size - 1);   break;
+    default: fuzz_manifest(data + 1, size - 1);  break;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include "../common/handshake.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+using namespace stx::transfer;
+
+static Handshake sample() {
+    FileMetadata meta;
+    meta.filename = "layer.tar";
+    meta.filesize = 123456789;
+    meta.lastConfirmedBlock = 42;
+
+    Handshake hs;
+    bool ok = makeHandshake(meta, localCapabilities(), hs);
+    assert(ok);
+    (void)ok;
+    return hs;
+}
+
+void test_handshake_roundtrip() {
+    Handshake hs = sample();
+    uint8_t buf[HANDSHAKE_MAX_SIZE];
+    size_t len = encodeHandshake(hs, buf, sizeof(buf));
+    assert(len == HANDSHAKE_FIXED_SIZE + 9);
+
+    Handshake out;
+    bool ok = decodeHandshake(buf, len, out);
+    assert(ok);
+    (void)ok;
+    FileMetadata meta = out.metadata();
+    assert(meta.filename == "layer.tar");
+    assert(meta.filesize == 123456789);
+    assert(meta.lastConfirmedBlock == 42);
+    assert(out.version == PROTOCOL_VERSION);
+    assert(out.caps.recordSizes == localCapabilities().recordSizes);
+    std::cout << "[PASS] Handshake encode/decode\n";
+}
+
+void test_handshake_rejects_malformed() {
+    Handshake hs = sample();
+    uint8_t buf[HANDSHAKE_MAX_SIZE];
+    size_t len = encodeHandshake(hs, buf, sizeof(buf));
+
+    Handshake out;
+    for (size_t cut = 0; cut < len; ++cut) {
+        bool ok = decodeHandshake(buf, cut, out);
+        assert(!ok);
+        (void)ok;
+    }
+
+    buf[0] ^= 0xFF;
+    bool badMagic = decodeHandshake(buf, len, out);
+    assert(!badMagic);
+    buf[0] ^= 0xFF;
+
+    std::memcpy(buf + HANDSHAKE_FIXED_SIZE, "../x", 4);
+    bool badName = decodeHandshake(buf, len, out);
+    assert(!badName);
+    (void)badMagic;
+    (void)badName;
+    std::cout << "[PASS] Handshake rejects malformed frames\n";
+}
+
+void test_negotiation() {
+    Capabilities local = localCapabilities();
+    Capabilities offer = local;
+    Capabilities chosen;
+
+    bool full = negotiate(offer, local, chosen);
+    assert(full);
+    assert(chosen.recordSizes == RECORD_64K);
+    assert(recordSize(chosen.recordSizes) == 64 * 1024);
+
+    offer.recordSizes = RECORD_4K | RECORD_16K;
+    bool smaller = negotiate(offer, local, chosen);
+    assert(smaller);
+    assert(chosen.recordSizes == RECORD_16K);
+
+    offer.ciphers = 1u << 7;
+    bool unknownCipher = negotiate(offer, local, chosen);
+    assert(!unknownCipher);
+    (void)full;
+    (void)smaller;
+    (void)unknownCipher;
+    std::cout << "[PASS] Capability negotiation\n";
+}
+
+int main() {
+    test_handshake_roundtrip();
+    test_handshake_rejects_malformed();
+    test_negotiation();
+    return 0;
+}
@@ -63,6 +63,33 @@ def run_standard_transfer():
           "Files match" if match else "Mismatch in files")
     return match
 
+def run_rename_transfer():
+    print("[TEST] 5MB transfer with --sync rename")
+    generate_test_file(FILE_ORIG, 5)
+
+    recv = subprocess.Popen(
+        [RECV_EXE, "--listen", "9000", "--out", RECV_DIR, "--sync", "rename"],
+        cwd=RECV_EXE_DIR
+    )
+    time.sleep(1)
+
+    subprocess.run([
+        SEND_EXE,
+        "127.0.0.1", "9000", FILE_ORIG,
+        "--key", SEND_KEY
+    ], check=True, cwd=SEND_EXE_DIR)
+
+    time.sleep(1)
+    recv.terminate()
+    recv.wait()
+    time.sleep(1)
+
+    match = (sha256sum(FILE_ORIG) == sha256sum(FILE_RECV)
+             and not os.path.exists(FILE_RECV + ".part"))
+    print("[PASS]" if match else "[FAIL]",
+          "Files match after rename" if match else "Mismatch or leftover .part file")
+    return match
+
 def run_resume_transfer():
     print("[TEST] Simulated disconnection/resume")
     generate_test_file(FILE_ORIG, 5)
@@ -108,6 +135,8 @@ def main():
     cleanup()
     results = [run_standard_transfer()]
     cleanup()
+    results.append(run_rename_transfer())
+    cleanup()
 
     if all(results):
         print("\nAll integration tests passed.")
@@ -0,0 +1,77 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include "../common/crypto.h"
+#include "../common/keystore.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace stx::crypto;
+
+// Per-connection key setup cost, per side. Sender: parsing the peer's public
+// PEM and encrypting with a fresh EVP_PKEY_CTX on every connection (old path)
+// vs. KeyStore::wrapSessionKey. Receiver: decrypting with a fresh
+// EVP_PKEY_CTX, private key loaded once at startup (old path), vs.
+// KeyStore::unwrapSessionKey. Usage: setup_bench [key_dir] [iterations]
+
+template <typename F>
+static double micros_per_iter(int iterations, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        body();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    const std::string dir  = argc > 1 ? argv[1] : "../../keys";
+    const int iterations   = argc > 2 ? std::stoi(argv[2]) : 200;
+    const std::string priv = dir + "/recv_priv.pem";
+    const std::string pub  = dir + "/recv_pub.pem";
+
+    try {
+        auto sessionKey = generateSessionKey();
+
+        KeyStore sendStore("", pub);
+        KeyStore recvStore(priv, "");
+        RSAKey myPriv(priv, true);
+        const auto wrapped = sendStore.wrapSessionKey(sessionKey);
+
+        double sendBefore = micros_per_iter(iterations, [&]() {
+            RSAKey peerPub(pub, false);
+            auto enc = rsaEncrypt(peerPub.get(), sessionKey);
+            if (enc.empty())
+                throw std::runtime_error("wrap failed");
+        });
+        double sendAfter = micros_per_iter(iterations, [&]() {
+            auto enc = sendStore.wrapSessionKey(sessionKey);
+            if (enc.empty())
+                throw std::runtime_error("wrap failed");
+        });
+
+        double recvBefore = micros_per_iter(iterations, [&]() {
+            auto plain = rsaDecrypt(myPriv.get(), wrapped);
+            if (plain.size() < sessionKey.size())
+                throw std::runtime_error("unwrap failed");
+        });
+        double recvAfter = micros_per_iter(iterations, [&]() {
+            auto plain = recvStore.unwrapSessionKey(wrapped);
+            if (plain != sessionKey)
+                throw std::runtime_error("unwrap failed");
+        });
+
+        std::cout << "Per-connection key setup (" << iterations << " iterations)\n"
+                  << "  sender   before (load PEM + encrypt): " << sendBefore << " us\n"
+                  << "  sender   after  (KeyStore wrap):      " << sendAfter  << " us\n"
+                  << "  receiver before (new ctx + decrypt):  " << recvBefore << " us\n"
+                  << "  receiver after  (KeyStore unwrap):    " << recvAfter  << " us\n";
+    } catch (const std::exception& ex) {
+        std::cerr << "[FAIL] Exception: " << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include "../common/transfer.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace stx;
+using namespace stx::transfer;
+
+static void putBE64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8)
+        p[i] = uint8_t(v);
+}
+
+static std::vector<uint8_t> manifest(const std::vector<uint64_t>& lengths) {
+    std::vector<uint8_t> buf(lengths.size() * MANIFEST_ENTRY_SIZE);
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        uint8_t* entry = buf.data() + i * MANIFEST_ENTRY_SIZE;
+        std::memset(entry, int(i + 1), sizeof(crypto::Sha256Digest));
+        putBE64(entry + sizeof(crypto::Sha256Digest), lengths[i]);
+    }
+    return buf;
+}
+
+void test_record_limits() {
+    bool smallest = checkRecordLengths(16, 16, 4096);
+    bool largest  = checkRecordLengths(16, 4096 + 16, 4096);
+    bool tooLarge = checkRecordLengths(16, 4096 + 32, 4096);
+    bool badIv    = checkRecordLengths(17, 16, 4096);
+    bool unpadded = checkRecordLengths(16, 20, 4096);
+    bool huge     = checkRecordLengths(16, uint64_t(1) << 40, 4096);
+    assert(smallest && largest);
+    assert(!tooLarge && !badIv && !unpadded && !huge);
+    (void)smallest; (void)largest; (void)tooLarge; (void)badIv; (void)unpadded; (void)huge;
+
+    uint8_t rec[RECORD_HEADER_SIZE + 32] = {};
+    putBE64(rec, 16);
+    putBE64(rec + 8 + 16, 32);
+
+    RecordView view;
+    size_t whole = decodeRecord(rec, sizeof(rec), 4096, view);
+    assert(whole == sizeof(rec));
+    assert(view.ciphertextLen == 32);
+    assert(view.ciphertext == rec + RECORD_HEADER_SIZE);
+
+    size_t header = decodeRecordHeader(rec, RECORD_HEADER_SIZE, 4096, view);
+    assert(header == RECORD_HEADER_SIZE);
+    assert(view.iv == rec + 8 && view.ciphertextLen == 32);
+
+    size_t truncated = decodeRecord(rec, sizeof(rec) - 1, 4096, view);
+    size_t overLimit = decodeRecord(rec, sizeof(rec), 8, view);
+    size_t shortHead = decodeRecordHeader(rec, RECORD_HEADER_SIZE - 1, 4096, view);
+    assert(truncated == 0 && overLimit == 0 && shortHead == 0);
+    (void)whole; (void)header; (void)truncated; (void)overLimit; (void)shortHead;
+    std::cout << "[PASS] Record length limits\n";
+}
+
+void test_manifest_decode() {
+    const uint64_t size = 3 * 8192 + 100;
+    auto buf = manifest({8192, 8192, 8192, 100});
+
+    std::vector<dedup::ChunkRef> chunks;
+    bool ok = decodeChunkManifest(buf.data(), buf.size(), 0, size, chunks);
+    assert(ok);
+    assert(chunks.size() == 4);
+    assert(chunks[2].offset == 2 * 8192);
+    assert(chunks[3].offset == 3 * 8192 && chunks[3].length == 100);
+    assert(chunks[1].hash[0] == 2);
+
+    // A later window continues from the caller's offset.
+    std::vector<dedup::ChunkRef> tail;
+    auto second = manifest({100});
+    bool cont = decodeChunkManifest(second.data(), second.size(), 3 * 8192, size, tail);
+    assert(cont && tail.size() == 1 && tail[0].offset == 3 * 8192);
+    (void)ok; (void)cont;
+    std::cout << "[PASS] Manifest decode\n";
+}
+
+void test_manifest_rejects_invalid() {
+    std::vector<dedup::ChunkRef> chunks;
+
+    auto zero = manifest({8192, 0});
+    bool zeroOk = decodeChunkManifest(zero.data(), zero.size(), 0, 1 << 20, chunks);
+
+    auto oversize = manifest({dedup::CHUNK_MAX_SIZE + 1});
+    bool oversizeOk = decodeChunkManifest(oversize.data(), oversize.size(), 0, 1 << 20, chunks);
+
+    auto pastEnd = manifest({8192, 8192});
+    bool pastEndOk = decodeChunkManifest(pastEnd.data(), pastEnd.size(), 0, 8192 + 1, chunks);
+
+    auto wrap = manifest({uint64_t(-1)});
+    bool wrapOk = decodeChunkManifest(wrap.data(), wrap.size(), 1, 1 << 20, chunks);
+
+    auto partial = manifest({8192});
+    bool partialOk = decodeChunkManifest(partial.data(), partial.size() - 1, 0, 8192, chunks);
+
+    bool offsetOk = decodeChunkManifest(partial.data(), partial.size(), 8192 + 1, 8192, chunks);
+
+    assert(!zeroOk && !oversizeOk && !pastEndOk && !wrapOk && !partialOk && !offsetOk);
+    (void)zeroOk; (void)oversizeOk; (void)pastEndOk; (void)wrapOk; (void)partialOk; (void)offsetOk;
+    std::cout << "[PASS] Manifest rejects invalid entries\n";
+}
+
+static const uint16_t TEST_PORT = 9001;
+
+// Sends `wire` over a fresh loopback connection and parses it as one window.
+static bool recv_window(net::SocketRAII& listener, const std::vector<uint8_t>& wire,
+                        uint64_t offset, uint64_t expected, std::vector<dedup::ChunkRef>& chunks) {
+    net::SocketRAII sender;
+    sender.connectTo("127.0.0.1", TEST_PORT);
+    net::SocketRAII receiver = listener.acceptClient();
+
+    bool sent = sendAll(sender.get(), reinterpret_cast<const char*>(wire.data()), wire.size());
+    assert(sent);
+    (void)sent;
+    shutdown(sender.get(), SD_SEND);
+    return recvChunkManifest(receiver.get(), chunks, offset, expected);
+}
+
+static std::vector<uint8_t> window(uint64_t count, const std::vector<uint8_t>& entries) {
+    std::vector<uint8_t> wire(sizeof(uint64_t));
+    putBE64(wire.data(), count);
+    wire.insert(wire.end(), entries.begin(), entries.end());
+    return wire;
+}
+
+void test_manifest_window_validation() {
+    net::SocketRAII listener;
+    listener.bindAndListen(TEST_PORT);
+    std::vector<dedup::ChunkRef> chunks;
+
+    bool valid = recv_window(listener, window(2, manifest({8192, 4096})), 8192, 3 * 8192, chunks);
+    assert(valid && chunks.size() == 2);
+    assert(chunks[0].offset == 8192 && chunks[1].offset == 2 * 8192);
+
+    bool end = recv_window(listener, window(0, {}), 3 * 8192, 3 * 8192, chunks);
+    assert(end && chunks.empty());
+
+    bool earlyEnd = recv_window(listener, window(0, {}), 8192, 3 * 8192, chunks);
+    bool oversize = recv_window(listener, window(MANIFEST_WINDOW + 1, {}), 0, uint64_t(1) << 40, chunks);
+    bool badLen   = recv_window(listener, window(1, manifest({0})), 0, 8192, chunks);
+    bool pastEnd  = recv_window(listener, window(1, manifest({8192})), 4096, 8192, chunks);
+    bool cutShort = recv_window(listener, window(2, manifest({8192})), 0, 3 * 8192, chunks);
+    assert(!earlyEnd && !oversize && !badLen && !pastEnd && !cutShort);
+    (void)valid; (void)end; (void)earlyEnd; (void)oversize; (void)badLen; (void)pastEnd; (void)cutShort;
+    std::cout << "[PASS] Manifest window validation\n";
+}
+
+int main() {
+    try {
+        net::initWinsock();
+        test_record_limits();
+        test_manifest_decode();
+        test_manifest_rejects_invalid();
+        test_manifest_window_validation();
+        net::cleanupWinsock();
+    } catch (const std::exception& ex) {
+        std::cerr << "[FAIL] Exception: " << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
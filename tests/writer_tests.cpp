@@ -0,0 +1,215 @@
+extern "C" {
+#include <openssl/applink.c>
+}
+
+#include "../common/common.h"
+#include "../common/writer.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace stx;
+using namespace stx::io;
+
+static const std::string OUT_PATH = "writer_test.bin";
+
+static uint64_t file_size(const std::string& path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return f ? static_cast<uint64_t>(f.tellg()) : 0;
+}
+
+static bool file_exists(const std::string& path) {
+    return std::ifstream(path, std::ios::binary).good();
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::string& data) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+static std::vector<uint8_t> pattern(size_t n, uint8_t seed) {
+    std::vector<uint8_t> v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = static_cast<uint8_t>(seed + i * 31);
+    return v;
+}
+
+static void cleanup() {
+    std::remove(OUT_PATH.c_str());
+    std::remove((OUT_PATH + ".part").c_str());
+}
+
+void test_writes_are_coalesced() {
+    cleanup();
+    auto data = pattern(WRITE_COALESCE_SIZE + 5000, 1);
+    {
+        FileWriter out(OUT_PATH, SyncPolicy::None, 0);
+
+        // Record-sized writes stay in memory until a full buffer is ready.
+        out.write(data.data(), 4096);
+        out.write(data.data() + 4096, 4096);
+        uint64_t buffered = file_size(OUT_PATH);
+        assert(buffered == 0);
+
+        out.write(data.data() + 8192, data.size() - 8192);
+        uint64_t flushed = file_size(OUT_PATH);
+        assert(flushed == WRITE_COALESCE_SIZE);
+
+        out.commit(data.size());
+        (void)buffered;
+        (void)flushed;
+    }
+    std::string disk = read_file(OUT_PATH);
+    assert(disk == std::string(data.begin(), data.end()));
+    std::cout << "[PASS] Writes are coalesced\n";
+}
+
+void test_partial_block_trimmed_on_first_write() {
+    cleanup();
+    auto head = pattern(3 * BLOCK_SIZE + 100, 2);
+    write_file(OUT_PATH, std::string(head.begin(), head.end()));
+
+    auto tail = pattern(BLOCK_SIZE + 7, 3);
+    {
+        uint64_t resume = FileWriter::resumeBlockOf(OUT_PATH, SyncPolicy::None);
+        assert(resume == 3);
+        FileWriter out(OUT_PATH, SyncPolicy::None, resume);
+
+        // Opening alone must not modify the file.
+        out.preallocate(uint64_t(1) << 62);
+        uint64_t untouched = file_size(OUT_PATH);
+        assert(untouched == head.size());
+        (void)untouched;
+
+        out.write(tail.data(), tail.size());
+        out.commit(3 * BLOCK_SIZE + tail.size());
+    }
+
+    std::string expected(head.begin(), head.begin() + 3 * BLOCK_SIZE);
+    expected.append(tail.begin(), tail.end());
+    std::string disk = read_file(OUT_PATH);
+    assert(disk == expected);
+    std::cout << "[PASS] Partial trailing block trimmed on first write\n";
+}
+
+void test_resume_block_after_interruption() {
+    cleanup();
+    auto data = pattern(5 * BLOCK_SIZE + 123, 4);
+    {
+        // No commit: the destructor keeps what was received.
+        FileWriter out(OUT_PATH, SyncPolicy::Periodic, 0);
+        out.write(data.data(), data.size());
+    }
+    uint64_t kept = file_size(OUT_PATH);
+    assert(kept == data.size());
+    (void)kept;
+
+    uint64_t resume = FileWriter::resumeBlockOf(OUT_PATH, SyncPolicy::Periodic);
+    assert(resume == 5);
+    (void)resume;
+    std::cout << "[PASS] Resume block after interruption\n";
+}
+
+void test_rename_commit() {
+    cleanup();
+    auto data = pattern(2 * BLOCK_SIZE, 5);
+    {
+        FileWriter out(OUT_PATH, SyncPolicy::Rename, 0);
+        out.write(data.data(), data.size());
+
+        // Short of the expected size: stays under .part for a later resume.
+        bool threw = false;
+        try {
+            out.commit(data.size() + 1);
+        }
+        catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        bool early = file_exists(OUT_PATH);
+        assert(!early);
+        (void)threw;
+        (void)early;
+    }
+    uint64_t partial = file_size(OUT_PATH + ".part");
+    assert(partial == data.size());
+    (void)partial;
+
+    auto more = pattern(100, 6);
+    {
+        uint64_t resume = FileWriter::resumeBlockOf(OUT_PATH, SyncPolicy::Rename);
+        assert(resume == 2);
+        FileWriter out(OUT_PATH, SyncPolicy::Rename, resume);
+        out.write(more.data(), more.size());
+        out.commit(data.size() + more.size());
+    }
+
+    bool leftover = file_exists(OUT_PATH + ".part");
+    assert(!leftover);
+    (void)leftover;
+    std::string expected(data.begin(), data.end());
+    expected.append(more.begin(), more.end());
+    std::string disk = read_file(OUT_PATH);
+    assert(disk == expected);
+    std::cout << "[PASS] Rename commit\n";
+}
+
+void test_resume_probe_and_restart() {
+    cleanup();
+
+    // Probing must not create the file.
+    uint64_t missing = FileWriter::resumeBlockOf(OUT_PATH, SyncPolicy::None);
+    bool created = file_exists(OUT_PATH);
+    assert(missing == 0 && !created);
+    (void)missing;
+    (void)created;
+
+    auto old = pattern(4 * BLOCK_SIZE, 7);
+    write_file(OUT_PATH, std::string(old.begin(), old.end()));
+
+    // More blocks than are on disk cannot be resumed.
+    bool threw = false;
+    try {
+        FileWriter out(OUT_PATH, SyncPolicy::None, 5);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    (void)threw;
+
+    // The peer now announces a smaller file: nothing on disk can be kept.
+    auto data = pattern(BLOCK_SIZE / 2, 8);
+    {
+        FileWriter out(OUT_PATH, SyncPolicy::None, 0);
+        out.write(data.data(), data.size());
+        out.commit(data.size());
+    }
+    std::string disk = read_file(OUT_PATH);
+    assert(disk == std::string(data.begin(), data.end()));
+    std::cout << "[PASS] Resume probe and restart from block 0\n";
+}
+
+int main() {
+    try {
+        test_writes_are_coalesced();
+        test_partial_block_trimmed_on_first_write();
+        test_resume_block_after_interruption();
+        test_rename_commit();
+        test_resume_probe_and_restart();
+        cleanup();
+    } catch (const std::exception& ex) {
+        std::cerr << "[FAIL] Exception: " << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}